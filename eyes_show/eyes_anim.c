@@ -0,0 +1,90 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stddef.h>
+#include "eyes_anim.h"
+
+static inline uint32_t token_count(const uint8_t **p, uint8_t token)
+{
+    uint32_t n = token & EYES_ANIM_COUNT_MASK;
+    if (n == 0) {
+        n = (*p)[0] | ((*p)[1] << 8);
+        *p += 2;
+    }
+    return n;
+}
+
+void eyes_anim_blit(const eyes_anim_t *anim, int index, uint16_t *canvas)
+{
+    const eyes_anim_frame_t *frame = &anim->frames[index];
+    const eyes_anim_area_t *area = &frame->area;
+    if (area->w == 0) {
+        return;
+    }
+    const uint16_t *palette = anim->palette;
+    const uint8_t *p = anim->data + frame->offset;
+    uint16_t *row = canvas + (size_t)area->y * anim->width + area->x;
+    uint32_t x = 0;
+    uint32_t left = (uint32_t)area->w * area->h;
+
+    while (left) {
+        uint8_t token = *p++;
+        uint32_t n = token_count(&p, token);
+        uint8_t op = token & EYES_ANIM_OP_MASK;
+        uint16_t color = op == EYES_ANIM_OP_RUN ? palette[*p++] : 0;
+        left -= n;
+        // A token may wrap over several rows of the area
+        while (n) {
+            uint32_t chunk = area->w - x < n ? area->w - x : n;
+            uint16_t *dst = row + x;
+            if (op == EYES_ANIM_OP_LITERAL) {
+                for (uint32_t i = 0; i < chunk; i++) {
+                    dst[i] = palette[p[i]];
+                }
+                p += chunk;
+            } else if (op == EYES_ANIM_OP_RUN) {
+                for (uint32_t i = 0; i < chunk; i++) {
+                    dst[i] = color;
+                }
+            }
+            n -= chunk;
+            x += chunk;
+            if (x == area->w) {
+                x = 0;
+                row += anim->width;
+            }
+        }
+    }
+}
+
+void eyes_anim_start(eyes_anim_player_t *player, const eyes_anim_t *anim, uint16_t *canvas, eyes_anim_area_t *dirty)
+{
+    player->anim = anim;
+    player->canvas = canvas;
+    player->frame = 0;
+    player->loops = 0;
+    eyes_anim_blit(anim, 0, canvas);
+    *dirty = anim->frames[0].area;
+}
+
+bool eyes_anim_next(eyes_anim_player_t *player, eyes_anim_area_t *dirty)
+{
+    const eyes_anim_t *anim = player->anim;
+    int index = player->frame + 1;
+    if (index == anim->frame_count) {
+        if (anim->loop_count && ++player->loops >= anim->loop_count) {
+            dirty->w = 0;
+            return false;
+        }
+        // The extra entry leads from the last frame back to the first
+        player->frame = 0;
+    } else {
+        player->frame = index;
+    }
+    eyes_anim_blit(anim, index, player->canvas);
+    *dirty = anim->frames[index].area;
+    return true;
+}
@@ -0,0 +1,128 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Pre-decoded eye animations, generated from the GIFs by tools/eyes_anim_convert.py.
+ *
+ * Frame 0 covers the whole image, every other frame only the area that changed since
+ * the frame before. An area is a stream of tokens filling it row by row: the top two
+ * bits select the operation, the low six bits the pixel count. A count of 0 means the
+ * count follows as a 16-bit little endian value.
+ *
+ * - LITERAL: count palette indices follow
+ * - SKIP: count pixels keep the previous frame
+ * - RUN: one palette index follows, repeated count times
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __has_include
+#if __has_include("sdkconfig.h")
+#include "sdkconfig.h"
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EYES_ANIM_OP_LITERAL    0x00
+#define EYES_ANIM_OP_SKIP       0x40
+#define EYES_ANIM_OP_RUN        0x80
+#define EYES_ANIM_OP_MASK       0xc0
+#define EYES_ANIM_COUNT_MASK    0x3f
+
+/* Palette entries are stored the way LVGL keeps a 16-bit lv_color_t in memory */
+#if CONFIG_LV_COLOR_16_SWAP
+#define EYES_ANIM_PX(c)         ((uint16_t)((((c) & 0xff) << 8) | ((c) >> 8)))
+#else
+#define EYES_ANIM_PX(c)         ((uint16_t)(c))
+#endif
+
+/**
+ * @brief Area of the image, in pixels
+ */
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint16_t w;     /*!< 0 if nothing changed */
+    uint16_t h;
+} eyes_anim_area_t;
+
+/**
+ * @brief One frame, the changes against the frame before
+ */
+typedef struct {
+    eyes_anim_area_t area;  /*!< Changed area */
+    uint16_t delay_ms;      /*!< Time the frame is shown */
+    uint32_t offset;        /*!< First token in eyes_anim_t::data */
+} eyes_anim_frame_t;
+
+/**
+ * @brief Animation in flash
+ */
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint16_t frame_count;
+    uint16_t loop_count;            /*!< Times the animation plays, 0 forever */
+    const uint16_t *palette;        /*!< RGB565 colors, transparent pixels hold LV_COLOR_CHROMA_KEY */
+    const eyes_anim_frame_t *frames;/*!< frame_count entries plus one that turns the last frame back into the first */
+    const uint8_t *data;            /*!< Tokens of all frames */
+} eyes_anim_t;
+
+/**
+ * @brief Playback state of one animation
+ */
+typedef struct {
+    const eyes_anim_t *anim;
+    uint16_t *canvas;       /*!< width * height RGB565 pixels, always holds the current frame */
+    uint16_t frame;         /*!< Frame in the canvas */
+    uint16_t loops;         /*!< Loops completed */
+} eyes_anim_player_t;
+
+/**
+ * @brief Draw a frame's changes into the canvas
+ *
+ * @param anim animation
+ * @param index entry of anim->frames, frame_count for the step back to frame 0
+ * @param canvas holds the frame before index, index 0 overwrites it completely
+ */
+void eyes_anim_blit(const eyes_anim_t *anim, int index, uint16_t *canvas);
+
+/**
+ * @brief Show the first frame of an animation
+ *
+ * @param player playback state
+ * @param anim animation, must fit the canvas
+ * @param canvas width * height pixels
+ * @param[out] dirty area to redraw, the whole image
+ */
+void eyes_anim_start(eyes_anim_player_t *player, const eyes_anim_t *anim, uint16_t *canvas, eyes_anim_area_t *dirty);
+
+/**
+ * @brief Advance to the next frame
+ *
+ * @param player playback state
+ * @param[out] dirty area to redraw
+ * @return false once the last loop ended, the canvas keeps the last frame
+ */
+bool eyes_anim_next(eyes_anim_player_t *player, eyes_anim_area_t *dirty);
+
+/**
+ * @brief Time the current frame is shown
+ */
+static inline uint32_t eyes_anim_delay_ms(const eyes_anim_player_t *player)
+{
+    return player->anim->frames[player->frame].delay_ms;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,139 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "bsp/esp-bsp.h"
+#include "show_eyes.h"
+#include "eyes_display.h"
+#include "eyes_ctrl.h"
+
+static const char *TAG = "eyes_ctrl";
+
+#define EYES_CTRL_TASK_STACK        4096
+// Below the capture task and the USB stack, a late animation is harmless
+#define EYES_CTRL_TASK_PRIORITY     2
+
+typedef enum {
+    EYES_STATE_STATIC = 0,
+    EYES_STATE_OPENING,
+    EYES_STATE_BLINKING,
+    EYES_STATE_CLOSING,
+} eyes_state_t;
+
+static struct {
+    QueueHandle_t queue;        // Length 1, overwritten by every post
+    eyes_ctrl_stats_t stats;
+} s_ctrl;
+
+// Blocks on the display lock as long as LVGL renders, only the controller task gets here
+static uint32_t eyes_ctrl_enter(lv_obj_t *img, eyes_state_t state)
+{
+    switch (state) {
+    case EYES_STATE_OPENING:
+        eyes_open(img);
+        break;
+    case EYES_STATE_BLINKING:
+        eyes_blink(img);
+        break;
+    case EYES_STATE_CLOSING:
+        eyes_close(img);
+        break;
+    default:
+        eyes_static(img);
+        break;
+    }
+    s_ctrl.stats.switches++;
+    return eyes_duration_ms(img);
+}
+
+static eyes_state_t eyes_ctrl_next(eyes_state_t state, eyes_event_t event)
+{
+    switch (event) {
+    case EYES_EVENT_STREAM_START:
+        return state == EYES_STATE_OPENING || state == EYES_STATE_BLINKING ? state : EYES_STATE_OPENING;
+    case EYES_EVENT_STREAM_STOP:
+        return state == EYES_STATE_CLOSING || state == EYES_STATE_STATIC ? state : EYES_STATE_CLOSING;
+    default:
+        return EYES_STATE_STATIC;
+    }
+}
+
+static void eyes_ctrl_task(void *arg)
+{
+    (void)arg;
+    if (!eyes_display_start()) {
+        vTaskDelete(NULL);
+    }
+    bsp_display_backlight_on();
+    bsp_display_lock(0);
+    lv_obj_t *img = eyes_init();
+    bsp_display_unlock();
+
+    eyes_state_t state = EYES_STATE_STATIC;
+    eyes_ctrl_enter(img, state);
+    // Opening and closing play once, then lead to blinking and static
+    bool transition = false;
+    TickType_t deadline = 0;
+    while (1) {
+        TickType_t wait = portMAX_DELAY;
+        if (transition) {
+            TickType_t now = xTaskGetTickCount();
+            wait = (int32_t)(deadline - now) > 0 ? deadline - now : 0;
+        }
+        eyes_event_t event;
+        eyes_state_t next;
+        if (xQueueReceive(s_ctrl.queue, &event, wait) == pdTRUE) {
+            s_ctrl.stats.applied++;
+            next = eyes_ctrl_next(state, event);
+            if (next == state) {
+                // Already there or on the way, an opening keeps its deadline
+                continue;
+            }
+        } else {
+            next = state == EYES_STATE_OPENING ? EYES_STATE_BLINKING : EYES_STATE_STATIC;
+        }
+        ESP_LOGD(TAG, "State %d -> %d", state, next);
+        state = next;
+        uint32_t duration_ms = eyes_ctrl_enter(img, state);
+        transition = state == EYES_STATE_OPENING || state == EYES_STATE_CLOSING;
+        deadline = xTaskGetTickCount() + pdMS_TO_TICKS(duration_ms);
+    }
+}
+
+esp_err_t eyes_ctrl_start(void)
+{
+    s_ctrl.queue = xQueueCreate(1, sizeof(eyes_event_t));
+    if (!s_ctrl.queue) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreatePinnedToCore(eyes_ctrl_task, "eyes_ctrl", EYES_CTRL_TASK_STACK, NULL,
+                                EYES_CTRL_TASK_PRIORITY, NULL, tskNO_AFFINITY) != pdPASS) {
+        vQueueDelete(s_ctrl.queue);
+        s_ctrl.queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void eyes_ctrl_post(eyes_event_t event)
+{
+    if (!s_ctrl.queue) {
+        return;
+    }
+    s_ctrl.stats.posted++;
+    // Never waits, a pending event is replaced by this one
+    xQueueOverwrite(s_ctrl.queue, &event);
+}
+
+void eyes_ctrl_get_stats(eyes_ctrl_stats_t *stats)
+{
+    *stats = s_ctrl.stats;
+    uint32_t pending = s_ctrl.queue ? uxQueueMessagesWaiting(s_ctrl.queue) : 0;
+    stats->coalesced = stats->posted - stats->applied - pending;
+}
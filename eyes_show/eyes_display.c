@@ -0,0 +1,60 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "bsp/esp-bsp.h"
+#include "eyes_display.h"
+
+static const char *TAG = "eyes_display";
+
+#define EYES_DRAW_BUF_PIXELS    (BSP_LCD_H_RES * CONFIG_EYES_DISPLAY_DRAW_BUF_LINES)
+#if CONFIG_EYES_DISPLAY_DRAW_BUF_DOUBLE
+#define EYES_DRAW_BUF_COUNT     2
+#else
+#define EYES_DRAW_BUF_COUNT     1
+#endif
+
+static lv_disp_t *s_disp;
+
+lv_disp_t *eyes_display_start(void)
+{
+    if (s_disp) {
+        return s_disp;
+    }
+    size_t internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    bsp_display_cfg_t cfg = {
+        .lvgl_port_cfg = ESP_LVGL_PORT_INIT_CONFIG(),
+        .buffer_size = EYES_DRAW_BUF_PIXELS,
+        .double_buffer = EYES_DRAW_BUF_COUNT == 2,
+        .flags = {
+            // The panel IO flushes with SPI DMA and signals LVGL from the transfer done
+            // interrupt, a second buffer lets LVGL render the next area meanwhile
+            .buff_dma = true,
+            .buff_spiram = false,
+        },
+    };
+    s_disp = bsp_display_start_with_config(&cfg);
+    if (!s_disp) {
+        ESP_LOGE(TAG, "Display init failed");
+        return NULL;
+    }
+    ESP_LOGI(TAG, "%d x %d line draw buffers in internal DMA RAM (%u bytes), display took %u bytes of internal RAM",
+             EYES_DRAW_BUF_COUNT, CONFIG_EYES_DISPLAY_DRAW_BUF_LINES,
+             (unsigned)(EYES_DRAW_BUF_COUNT * EYES_DRAW_BUF_PIXELS * sizeof(lv_color_t)),
+             (unsigned)(internal_free - heap_caps_get_free_size(MALLOC_CAP_INTERNAL)));
+    return s_disp;
+}
+
+void *eyes_display_alloc(size_t size)
+{
+    // Internal RAM is left to the UVC buffer and the camera DMA descriptors
+    void *buf = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!buf) {
+        buf = heap_caps_malloc(size, MALLOC_CAP_DEFAULT);
+    }
+    return buf;
+}
@@ -0,0 +1,63 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief What the eyes react to
+ */
+typedef enum {
+    EYES_EVENT_STREAM_START = 0,    /*!< Open the eyes, then keep blinking */
+    EYES_EVENT_STREAM_STOP,         /*!< Close the eyes, then show the static eyes */
+    EYES_EVENT_SUSPEND,             /*!< Show the static eyes right away, nothing is animated */
+} eyes_event_t;
+
+/**
+ * @brief Counters of the controller, cumulative since boot
+ */
+typedef struct {
+    uint32_t posted;        /*!< Events posted */
+    uint32_t applied;       /*!< Events the controller task acted on */
+    uint32_t coalesced;     /*!< Events replaced by a later one before the task read them */
+    uint32_t switches;      /*!< Animations started, including the follow-up ones */
+} eyes_ctrl_stats_t;
+
+/**
+ * @brief Start the display and the controller task, the eyes start static
+ *
+ * The display is brought up by the task, this returns without waiting for it.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the queue or the task cannot be created
+ */
+esp_err_t eyes_ctrl_start(void);
+
+/**
+ * @brief Post an event, never blocks
+ *
+ * Only the latest event is kept: one posted before the task read the previous one
+ * replaces it, so rapid transitions end in the last state without playing the ones
+ * in between. Safe to call from the UVC callbacks, the display lock is only taken
+ * by the controller task. Ignored before eyes_ctrl_start.
+ *
+ * @param event what happened
+ */
+void eyes_ctrl_post(eyes_event_t event);
+
+/**
+ * @brief Read the counters
+ */
+void eyes_ctrl_get_stats(eyes_ctrl_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
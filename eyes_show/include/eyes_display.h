@@ -0,0 +1,40 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Start the LCD and LVGL with the memory placement of the webcam
+ *
+ * Draw buffers come from internal DMA-capable RAM, sized by
+ * CONFIG_EYES_DISPLAY_DRAW_BUF_LINES, everything the display shows is meant
+ * to be allocated with eyes_display_alloc. Starts the display once, later
+ * calls return the same display.
+ *
+ * @return the display, NULL if it could not be started
+ */
+lv_disp_t *eyes_display_start(void);
+
+/**
+ * @brief Allocate pixels or frames for the display from PSRAM
+ *
+ * Falls back to the default heap on boards without PSRAM.
+ *
+ * @param size bytes
+ * @return the buffer, NULL if out of memory
+ */
+void *eyes_display_alloc(size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -11,3 +11,5 @@ lv_obj_t* eyes_open(lv_obj_t* img);
 lv_obj_t* eyes_close(lv_obj_t* img);
 lv_obj_t* eyes_blink(lv_obj_t* img);
 lv_obj_t* eyes_static(lv_obj_t* img);
+/* Length of one loop of the animation img plays, 0 for the static eyes */
+uint32_t eyes_duration_ms(lv_obj_t* img);
@@ -8,52 +8,161 @@
 #include "freertos/task.h"
 #include "bsp/esp-bsp.h"
 #include "show_eyes.h"
+#include "eyes_anim.h"
+#include "eyes_display.h"
+
+#if LV_COLOR_DEPTH != 16
+#error "The eye animations are pre-decoded to RGB565"
+#endif
+
+/* Image source of the animations, handled by the decoder below */
+#define EYES_ANIM_CF    LV_IMG_CF_USER_ENCODED_0
 
-LV_IMG_DECLARE(img_open_eyes);
-LV_IMG_DECLARE(img_blink_eyes);
-LV_IMG_DECLARE(img_close_eyes);
 LV_IMG_DECLARE(img_static_eyes);
 
+extern const eyes_anim_t anim_open_eyes;
+extern const eyes_anim_t anim_blink_eyes;
+extern const eyes_anim_t anim_close_eyes;
+
+static struct {
+    lv_obj_t *img;
+    lv_timer_t *timer;
+    eyes_anim_player_t player;
+    lv_img_dsc_t src;       // Points the decoder at the player
+    uint16_t *canvas;
+} s_eyes;
+
+static lv_res_t eyes_decoder_info(lv_img_decoder_t *decoder, const void *src, lv_img_header_t *header)
+{
+    (void)decoder;
+    if (lv_img_src_get_type(src) != LV_IMG_SRC_VARIABLE || ((const lv_img_dsc_t *)src)->header.cf != EYES_ANIM_CF) {
+        return LV_RES_INV;
+    }
+    header->w = ((const lv_img_dsc_t *)src)->header.w;
+    header->h = ((const lv_img_dsc_t *)src)->header.h;
+    header->cf = LV_IMG_CF_TRUE_COLOR_CHROMA_KEYED;
+    return LV_RES_OK;
+}
+
+static lv_res_t eyes_decoder_open(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+    (void)decoder;
+    const lv_img_dsc_t *src = dsc->src;
+    if (dsc->src_type != LV_IMG_SRC_VARIABLE || src->header.cf != EYES_ANIM_CF) {
+        return LV_RES_INV;
+    }
+    // Nothing to decode, the player keeps the current frame in the canvas
+    const eyes_anim_player_t *player = (const eyes_anim_player_t *)src->data;
+    dsc->img_data = (const uint8_t *)player->canvas;
+    return LV_RES_OK;
+}
+
+static void eyes_invalidate(const eyes_anim_area_t *dirty)
+{
+    if (dirty->w == 0) {
+        return;
+    }
+    lv_area_t area = {
+        .x1 = s_eyes.img->coords.x1 + dirty->x,
+        .y1 = s_eyes.img->coords.y1 + dirty->y,
+        .x2 = s_eyes.img->coords.x1 + dirty->x + dirty->w - 1,
+        .y2 = s_eyes.img->coords.y1 + dirty->y + dirty->h - 1,
+    };
+    // Only the changed area is rendered and flushed
+    lv_obj_invalidate_area(s_eyes.img, &area);
+}
+
+static void eyes_timer_cb(lv_timer_t *timer)
+{
+    eyes_anim_area_t dirty;
+    if (!eyes_anim_next(&s_eyes.player, &dirty)) {
+        lv_timer_pause(timer);
+        return;
+    }
+    eyes_invalidate(&dirty);
+    lv_timer_set_period(timer, eyes_anim_delay_ms(&s_eyes.player));
+}
+
+static lv_obj_t *eyes_play(lv_obj_t *img, const eyes_anim_t *anim)
+{
+    eyes_anim_area_t dirty;
+    LV_ASSERT(anim->width == s_eyes.src.header.w && anim->height == s_eyes.src.header.h);
+    bsp_display_lock(0);
+    eyes_anim_start(&s_eyes.player, anim, s_eyes.canvas, &dirty);
+    if (lv_img_get_src(img) != &s_eyes.src) {
+        lv_img_set_src(img, &s_eyes.src);
+        lv_obj_align(img, LV_ALIGN_CENTER, 0, 0);
+    }
+    lv_obj_invalidate(img);
+    lv_timer_set_period(s_eyes.timer, eyes_anim_delay_ms(&s_eyes.player));
+    lv_timer_reset(s_eyes.timer);
+    lv_timer_resume(s_eyes.timer);
+    bsp_display_unlock();
+    return img;
+}
+
 lv_obj_t *eyes_init()
 {
     lv_obj_t *f_img = lv_scr_act();
     lv_obj_clear_flag(f_img, LV_OBJ_FLAG_SCROLLABLE);
-    lv_obj_t *img = lv_gif_create(f_img);
-    return img;
+
+    lv_img_decoder_t *decoder = lv_img_decoder_create();
+    lv_img_decoder_set_info_cb(decoder, eyes_decoder_info);
+    lv_img_decoder_set_open_cb(decoder, eyes_decoder_open);
+
+    // All animations share the canvas, they have the same size. LVGL reads it through the
+    // cache while it renders, only the draw buffers need internal RAM
+    s_eyes.canvas = eyes_display_alloc(anim_open_eyes.width * anim_open_eyes.height * sizeof(uint16_t));
+    LV_ASSERT_MALLOC(s_eyes.canvas);
+    s_eyes.src = (lv_img_dsc_t) {
+        .header.cf = EYES_ANIM_CF,
+        .header.w = anim_open_eyes.width,
+        .header.h = anim_open_eyes.height,
+        .data_size = sizeof(s_eyes.player),
+        .data = (const uint8_t *)&s_eyes.player,
+    };
+    s_eyes.timer = lv_timer_create(eyes_timer_cb, 100, NULL);
+    lv_timer_pause(s_eyes.timer);
+
+    s_eyes.img = lv_img_create(f_img);
+    return s_eyes.img;
 }
 
 lv_obj_t *eyes_open(lv_obj_t *img)
 {
-    bsp_display_lock(0);
-    lv_gif_set_src(img, &img_open_eyes);
-    lv_obj_align(img, LV_ALIGN_CENTER, 0, 0);
-    bsp_display_unlock();
-    return img;
+    return eyes_play(img, &anim_open_eyes);
 }
 
 lv_obj_t *eyes_blink(lv_obj_t *img)
 {
-    bsp_display_lock(0);
-    lv_gif_set_src(img, &img_blink_eyes);
-    lv_obj_align(img, LV_ALIGN_CENTER, 0, 0);
-    bsp_display_unlock();
-    return img;
+    return eyes_play(img, &anim_blink_eyes);
 }
 
 lv_obj_t *eyes_close(lv_obj_t *img)
 {
-    bsp_display_lock(0);
-    lv_gif_set_src(img, &img_close_eyes);
-    lv_obj_align(img, LV_ALIGN_CENTER, 0, 0);
-    bsp_display_unlock();
-    return img;
+    return eyes_play(img, &anim_close_eyes);
 }
 
 lv_obj_t *eyes_static(lv_obj_t *img)
 {
     bsp_display_lock(0);
+    lv_timer_pause(s_eyes.timer);
     lv_img_set_src(img, &img_static_eyes);
     lv_obj_align(img, LV_ALIGN_CENTER, 0, 0);
     bsp_display_unlock();
     return img;
 }
+
+uint32_t eyes_duration_ms(lv_obj_t *img)
+{
+    // The player is only restarted by the caller's task, reading it needs no lock
+    if (lv_img_get_src(img) != &s_eyes.src) {
+        return 0;
+    }
+    const eyes_anim_t *anim = s_eyes.player.anim;
+    uint32_t duration_ms = 0;
+    for (int i = 0; i < anim->frame_count; i++) {
+        duration_ms += anim->frames[i].delay_ms;
+    }
+    return duration_ms;
+}
@@ -0,0 +1,281 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Decode cost per frame of the eye animations: the GIFs as lv_gif plays them against
+ * the pre-decoded animations of eyes_anim.h.
+ *
+ * The GIF side is a reference decoder doing the per-frame work of LVGL's gifdec: LZW
+ * decode of the frame into palette indices, then the palette lookup into a 32-bit
+ * canvas, skipping transparent pixels, plus the disposal of the previous frame. lv_gif
+ * also invalidates the whole image every frame, the pre-decoded player only the area
+ * that changed, so the pixels LVGL has to render and flush are reported as well.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lvgl.h"
+#include "eyes_anim.h"
+
+// Frames decoded per animation and decoder
+#define BENCH_FRAMES    2000
+
+LV_IMG_DECLARE(img_open_eyes);
+LV_IMG_DECLARE(img_blink_eyes);
+LV_IMG_DECLARE(img_close_eyes);
+
+extern const eyes_anim_t anim_open_eyes;
+extern const eyes_anim_t anim_blink_eyes;
+extern const eyes_anim_t anim_close_eyes;
+
+typedef struct {
+    uint16_t length;
+    uint16_t prefix;
+    uint8_t suffix;
+} lzw_entry_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+    size_t anim_start;
+    uint16_t width;
+    uint16_t height;
+    uint8_t gct[256 * 3];
+    uint8_t bgindex;
+    int disposal;
+    int transparent;
+    uint16_t fx, fy, fw, fh;
+    uint8_t *frame;         // Palette indices of the whole screen
+    uint32_t *canvas;       // ARGB8888, what lv_gif draws
+    lzw_entry_t table[4096];
+} gif_ref_t;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void gif_ref_open(gif_ref_t *gif, const uint8_t *data, size_t size)
+{
+    memset(gif, 0, sizeof(*gif));
+    gif->data = data;
+    gif->size = size;
+    gif->width = data[6] | data[7] << 8;
+    gif->height = data[8] | data[9] << 8;
+    uint8_t flags = data[10];
+    gif->bgindex = data[11];
+    gif->pos = 13;
+    if (flags & 0x80) {
+        int colors = 2 << (flags & 7);
+        memcpy(gif->gct, data + gif->pos, colors * 3);
+        gif->pos += colors * 3;
+    }
+    gif->anim_start = gif->pos;
+    gif->frame = calloc((size_t)gif->width * gif->height, 1);
+    gif->canvas = calloc((size_t)gif->width * gif->height, sizeof(uint32_t));
+    gif->transparent = -1;
+}
+
+static void gif_ref_close(gif_ref_t *gif)
+{
+    free(gif->frame);
+    free(gif->canvas);
+}
+
+static size_t skip_sub_blocks(const uint8_t *data, size_t pos)
+{
+    while (data[pos]) {
+        pos += data[pos] + 1;
+    }
+    return pos + 1;
+}
+
+// LZW decode of one image into gif->frame, sub-blocks are read as the codes need them
+static void gif_ref_lzw(gif_ref_t *gif)
+{
+    const uint8_t *data = gif->data;
+    int min_code_size = data[gif->pos++];
+    int clear = 1 << min_code_size;
+    int stop = clear + 1;
+    int code_size = min_code_size + 1;
+    int table_len = clear + 2;
+    size_t block_left = data[gif->pos++];
+    uint32_t bits = 0;
+    int nbits = 0;
+    int prev = -1;
+    uint32_t pixels = (uint32_t)gif->fw * gif->fh;
+    uint32_t out = 0;
+
+    for (int i = 0; i < clear; i++) {
+        gif->table[i] = (lzw_entry_t) { 1, 0xfff, (uint8_t)i };
+    }
+    while (out < pixels) {
+        while (nbits < code_size) {
+            if (block_left == 0) {
+                block_left = data[gif->pos++];
+                if (block_left == 0) {
+                    goto done;
+                }
+            }
+            bits |= (uint32_t)data[gif->pos++] << nbits;
+            nbits += 8;
+            block_left--;
+        }
+        int code = bits & ((1 << code_size) - 1);
+        bits >>= code_size;
+        nbits -= code_size;
+        if (code == clear) {
+            code_size = min_code_size + 1;
+            table_len = clear + 2;
+            prev = -1;
+            continue;
+        }
+        if (code == stop) {
+            break;
+        }
+        if (prev >= 0 && table_len < 4096) {
+            int first = code < table_len ? code : prev;
+            while (gif->table[first].prefix != 0xfff) {
+                first = gif->table[first].prefix;
+            }
+            gif->table[table_len] = (lzw_entry_t) {
+                gif->table[prev].length + 1, (uint16_t)prev, gif->table[first].suffix
+            };
+            table_len++;
+            if (table_len == (1 << code_size) && code_size < 12) {
+                code_size++;
+            }
+        }
+        // Strings are stored back to front, write them from their last pixel
+        int len = gif->table[code].length;
+        for (int i = len - 1, c = code; i >= 0; i--, c = gif->table[c].prefix) {
+            uint32_t p = out + i;
+            if (p < pixels) {
+                gif->frame[(size_t)(gif->fy + p / gif->fw) * gif->width + gif->fx + p % gif->fw] = gif->table[c].suffix;
+            }
+        }
+        out += len;
+        prev = code;
+    }
+    // Skip what is left of the image data, up to and with the block terminator
+    gif->pos = skip_sub_blocks(data, gif->pos + block_left);
+done:
+    return;
+}
+
+static void gif_ref_render(gif_ref_t *gif, const uint8_t *palette)
+{
+    for (int y = gif->fy; y < gif->fy + gif->fh; y++) {
+        for (int x = gif->fx; x < gif->fx + gif->fw; x++) {
+            size_t i = (size_t)y * gif->width + x;
+            int index = gif->frame[i];
+            if (index == gif->transparent) {
+                continue;
+            }
+            const uint8_t *c = &palette[index * 3];
+            gif->canvas[i] = 0xff000000 | c[0] << 16 | c[1] << 8 | c[2];
+        }
+    }
+}
+
+static void gif_ref_dispose(gif_ref_t *gif)
+{
+    if (gif->disposal != 2) {
+        return;
+    }
+    const uint8_t *c = &gif->gct[gif->bgindex * 3];
+    uint32_t bg = (gif->transparent >= 0 ? 0 : 0xff000000) | c[0] << 16 | c[1] << 8 | c[2];
+    for (int y = gif->fy; y < gif->fy + gif->fh; y++) {
+        for (int x = gif->fx; x < gif->fx + gif->fw; x++) {
+            gif->canvas[(size_t)y * gif->width + x] = bg;
+        }
+    }
+}
+
+// Decode the next frame, rewinding at the end like a looping lv_gif
+static void gif_ref_next(gif_ref_t *gif)
+{
+    const uint8_t *data = gif->data;
+    gif_ref_dispose(gif);
+    while (1) {
+        if (gif->pos >= gif->size || data[gif->pos] == 0x3b) {
+            gif->pos = gif->anim_start;
+            continue;
+        }
+        uint8_t block = data[gif->pos++];
+        if (block == 0x21) {
+            uint8_t label = data[gif->pos++];
+            if (label == 0xf9) {
+                uint8_t packed = data[gif->pos + 1];
+                gif->disposal = (packed >> 2) & 7;
+                gif->transparent = packed & 1 ? data[gif->pos + 4] : -1;
+            }
+            gif->pos = skip_sub_blocks(data, gif->pos);
+            continue;
+        }
+        // Image descriptor
+        gif->fx = data[gif->pos] | data[gif->pos + 1] << 8;
+        gif->fy = data[gif->pos + 2] | data[gif->pos + 3] << 8;
+        gif->fw = data[gif->pos + 4] | data[gif->pos + 5] << 8;
+        gif->fh = data[gif->pos + 6] | data[gif->pos + 7] << 8;
+        uint8_t flags = data[gif->pos + 8];
+        gif->pos += 9;
+        const uint8_t *palette = gif->gct;
+        if (flags & 0x80) {
+            palette = data + gif->pos;
+            gif->pos += 3 * (2 << (flags & 7));
+        }
+        gif_ref_lzw(gif);
+        gif_ref_render(gif, palette);
+        return;
+    }
+}
+
+static void bench(const char *name, const lv_img_dsc_t *gif_src, const eyes_anim_t *anim)
+{
+    gif_ref_t *gif = malloc(sizeof(*gif));
+    gif_ref_open(gif, gif_src->data, gif_src->data_size);
+    int64_t start = now_ns();
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        gif_ref_next(gif);
+    }
+    int64_t gif_ns = now_ns() - start;
+    uint64_t full_px = (uint64_t)gif->width * gif->height;
+    gif_ref_close(gif);
+    free(gif);
+
+    // One canvas for all animations, as on the board
+    uint16_t *canvas = malloc((size_t)anim->width * anim->height * sizeof(uint16_t));
+    eyes_anim_player_t player;
+    eyes_anim_area_t dirty;
+    uint64_t dirty_px = 0;
+    start = now_ns();
+    eyes_anim_start(&player, anim, canvas, &dirty);
+    for (int i = 1; i < BENCH_FRAMES; i++) {
+        eyes_anim_next(&player, &dirty);
+        dirty_px += (uint64_t)dirty.w * dirty.h;
+    }
+    int64_t anim_ns = now_ns() - start;
+    free(canvas);
+
+    printf("%-12s %3d frames  lv_gif %7.1f us/frame  pre-decoded %6.1f us/frame  %5.1fx  redraw %5.1f%% of the image\n",
+           name, anim->frame_count, gif_ns / 1000.0 / BENCH_FRAMES, anim_ns / 1000.0 / BENCH_FRAMES,
+           (double)gif_ns / (anim_ns ? anim_ns : 1), 100.0 * dirty_px / (full_px * (BENCH_FRAMES - 1)));
+}
+
+int main(void)
+{
+    printf("Decode cost per frame, average over %d frames\n", BENCH_FRAMES);
+    bench("open_eyes", &img_open_eyes, &anim_open_eyes);
+    bench("blink_eyes", &img_blink_eyes, &anim_blink_eyes);
+    bench("close_eyes", &img_close_eyes, &anim_close_eyes);
+    return 0;
+}
@@ -0,0 +1,196 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Test of the frame slot pool of frame_pool.c.
+ *
+ * After the single-threaded checks, a fake camera lends its frame buffers through the
+ * pool like camera_fb_get_cb does: the camera thread claims a slot per frame and
+ * several USB threads return them concurrently, mapping each slot back to the camera
+ * buffer it carries. Every slot and every camera buffer must have exactly one owner at
+ * a time, and all of them must be back once the frames are done.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include "frame_pool.h"
+
+#define TEST_CAMERA_FB_COUNT    2   // CONFIG_CAMERA_FB_COUNT of the host simulation
+#define TEST_USB_THREADS        3
+#define TEST_FRAMES             200000
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+typedef struct {
+    atomic_int owner;       // Slot that carries the buffer, -1 while the driver has it
+    uint32_t seq;
+} fake_cam_fb_t;
+
+// fb_t of usb_webcam_main.c, the slot storage that sits next to the pool
+typedef struct {
+    atomic_int used;
+    fake_cam_fb_t *cam;
+    uint32_t seq;
+} test_slot_t;
+
+static struct {
+    frame_pool_t pool;
+    test_slot_t slots[TEST_CAMERA_FB_COUNT];
+    fake_cam_fb_t cam[TEST_CAMERA_FB_COUNT];
+    pthread_mutex_t lock;   // The queue of sent frames, the USB stack of the test
+    pthread_cond_t cond;
+    int queue[TEST_FRAMES];
+    int queue_head;
+    int queue_tail;
+    bool done;
+    atomic_uint returned;
+    atomic_int max_in_flight;
+} s_test = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void test_single_thread(void)
+{
+    frame_pool_t pool;
+    frame_pool_init(&pool, 3);
+    CHECK(frame_pool_in_flight(&pool) == 0);
+    CHECK(frame_pool_acquire(&pool) == 0);
+    CHECK(frame_pool_acquire(&pool) == 1);
+    CHECK(frame_pool_acquire(&pool) == 2);
+    CHECK(frame_pool_acquire(&pool) == -1);
+    CHECK(frame_pool_in_flight(&pool) == 3);
+    frame_pool_release(&pool, 1);
+    CHECK(frame_pool_in_flight(&pool) == 2);
+    CHECK(frame_pool_acquire(&pool) == 1);
+    frame_pool_release(&pool, 0);
+    frame_pool_release(&pool, 2);
+    frame_pool_release(&pool, 1);
+    CHECK(frame_pool_in_flight(&pool) == 0);
+
+    frame_pool_init(&pool, FRAME_POOL_MAX_SLOTS);
+    for (int i = 0; i < FRAME_POOL_MAX_SLOTS; i++) {
+        CHECK(frame_pool_acquire(&pool) == i);
+    }
+    CHECK(frame_pool_acquire(&pool) == -1);
+    CHECK(frame_pool_in_flight(&pool) == FRAME_POOL_MAX_SLOTS);
+    frame_pool_release(&pool, FRAME_POOL_MAX_SLOTS - 1);
+    CHECK(frame_pool_acquire(&pool) == FRAME_POOL_MAX_SLOTS - 1);
+}
+
+// esp_camera_fb_get of the fake driver, any buffer no slot carries
+static fake_cam_fb_t *fake_camera_fb_get(void)
+{
+    for (int i = 0; i < TEST_CAMERA_FB_COUNT; i++) {
+        int expected = -1;
+        if (atomic_compare_exchange_strong(&s_test.cam[i].owner, &expected, TEST_CAMERA_FB_COUNT)) {
+            return &s_test.cam[i];
+        }
+    }
+    return NULL;
+}
+
+static void *camera_thread(void *arg)
+{
+    (void)arg;
+    for (uint32_t seq = 0; seq < TEST_FRAMES; seq++) {
+        int slot;
+        // camera_fb_get_cb only waits for a free slot, the driver has one then too
+        while ((slot = frame_pool_acquire(&s_test.pool)) < 0) {
+            sched_yield();
+        }
+        int in_flight = frame_pool_in_flight(&s_test.pool);
+        CHECK(in_flight <= TEST_CAMERA_FB_COUNT);
+        if (in_flight > atomic_load(&s_test.max_in_flight)) {
+            atomic_store(&s_test.max_in_flight, in_flight);
+        }
+        test_slot_t *fb = &s_test.slots[slot];
+        CHECK(atomic_exchange(&fb->used, 1) == 0);
+        fake_cam_fb_t *cam = fake_camera_fb_get();
+        CHECK(cam != NULL);
+        atomic_store(&cam->owner, slot);
+        cam->seq = seq;
+        fb->cam = cam;
+        fb->seq = seq;
+
+        pthread_mutex_lock(&s_test.lock);
+        s_test.queue[s_test.queue_tail++] = slot;
+        pthread_cond_signal(&s_test.cond);
+        pthread_mutex_unlock(&s_test.lock);
+    }
+    pthread_mutex_lock(&s_test.lock);
+    s_test.done = true;
+    pthread_cond_broadcast(&s_test.cond);
+    pthread_mutex_unlock(&s_test.lock);
+    return NULL;
+}
+
+static void *usb_thread(void *arg)
+{
+    (void)arg;
+    while (1) {
+        pthread_mutex_lock(&s_test.lock);
+        while (s_test.queue_head == s_test.queue_tail && !s_test.done) {
+            pthread_cond_wait(&s_test.cond, &s_test.lock);
+        }
+        if (s_test.queue_head == s_test.queue_tail) {
+            pthread_mutex_unlock(&s_test.lock);
+            return NULL;
+        }
+        int slot = s_test.queue[s_test.queue_head++];
+        pthread_mutex_unlock(&s_test.lock);
+
+        // camera_fb_return_cb: from the slot to the camera buffer it carries
+        test_slot_t *fb = &s_test.slots[slot];
+        fake_cam_fb_t *cam = fb->cam;
+        CHECK(atomic_load(&fb->used) == 1);
+        CHECK(atomic_load(&cam->owner) == slot);
+        CHECK(cam->seq == fb->seq);
+        atomic_store(&cam->owner, -1);
+        atomic_store(&fb->used, 0);
+        frame_pool_release(&s_test.pool, slot);
+        atomic_fetch_add(&s_test.returned, 1);
+    }
+}
+
+int main(void)
+{
+    test_single_thread();
+
+    frame_pool_init(&s_test.pool, TEST_CAMERA_FB_COUNT);
+    for (int i = 0; i < TEST_CAMERA_FB_COUNT; i++) {
+        atomic_init(&s_test.cam[i].owner, -1);
+        atomic_init(&s_test.slots[i].used, 0);
+    }
+    pthread_t camera;
+    pthread_t usb[TEST_USB_THREADS];
+    for (int i = 0; i < TEST_USB_THREADS; i++) {
+        CHECK(pthread_create(&usb[i], NULL, usb_thread, NULL) == 0);
+    }
+    CHECK(pthread_create(&camera, NULL, camera_thread, NULL) == 0);
+    pthread_join(camera, NULL);
+    for (int i = 0; i < TEST_USB_THREADS; i++) {
+        pthread_join(usb[i], NULL);
+    }
+
+    CHECK(atomic_load(&s_test.returned) == TEST_FRAMES);
+    CHECK(frame_pool_in_flight(&s_test.pool) == 0);
+    for (int i = 0; i < TEST_CAMERA_FB_COUNT; i++) {
+        CHECK(atomic_load(&s_test.cam[i].owner) == -1);
+    }
+    printf("frame_pool: %d frames through %d slots from %d USB threads, up to %d in flight\n",
+           TEST_FRAMES, TEST_CAMERA_FB_COUNT, TEST_USB_THREADS, atomic_load(&s_test.max_in_flight));
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Test of the single-producer/single-consumer ring of frame_ring.c.
+ *
+ * After the single-threaded checks of the full and empty ring, a producer thread
+ * pushes numbered entries as fast as the ring takes them, like the capture task, and a
+ * consumer thread pops them, like fb_get_cb. Every entry must arrive once and in order,
+ * also while the free running indexes wrap around.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include "frame_ring.h"
+
+#define TEST_ITEMS      2000000
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+// Entries are numbers from 1, NULL means empty
+#define ITEM(n)     ((void *)(uintptr_t)(n))
+
+static frame_ring_t s_ring;
+
+static void test_single_thread(unsigned start)
+{
+    frame_ring_t ring;
+    frame_ring_init(&ring);
+    atomic_store(&ring.head, start);
+    atomic_store(&ring.tail, start);
+    CHECK(frame_ring_pop(&ring) == NULL);
+    CHECK(frame_ring_count(&ring) == 0);
+    for (int i = 1; i <= FRAME_RING_SIZE; i++) {
+        CHECK(frame_ring_push(&ring, ITEM(i)));
+    }
+    CHECK(!frame_ring_push(&ring, ITEM(FRAME_RING_SIZE + 1)));
+    CHECK(frame_ring_count(&ring) == FRAME_RING_SIZE);
+    CHECK(frame_ring_pop(&ring) == ITEM(1));
+    CHECK(frame_ring_push(&ring, ITEM(FRAME_RING_SIZE + 1)));
+    for (int i = 2; i <= FRAME_RING_SIZE + 1; i++) {
+        CHECK(frame_ring_pop(&ring) == ITEM(i));
+    }
+    CHECK(frame_ring_pop(&ring) == NULL);
+    CHECK(frame_ring_count(&ring) == 0);
+}
+
+static void *producer_thread(void *arg)
+{
+    unsigned *full = arg;
+    for (uintptr_t n = 1; n <= TEST_ITEMS; n++) {
+        while (!frame_ring_push(&s_ring, ITEM(n))) {
+            (*full)++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void *consumer_thread(void *arg)
+{
+    unsigned *empty = arg;
+    uintptr_t expected = 1;
+    while (expected <= TEST_ITEMS) {
+        void *item = frame_ring_pop(&s_ring);
+        if (!item) {
+            (*empty)++;
+            sched_yield();
+            continue;
+        }
+        CHECK((uintptr_t)item == expected);
+        expected++;
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    test_single_thread(0);
+    // The indexes run freely, the fill level must survive their wrap around
+    test_single_thread(UINT_MAX - FRAME_RING_SIZE / 2);
+
+    frame_ring_init(&s_ring);
+    atomic_store(&s_ring.head, UINT_MAX - TEST_ITEMS / 2);
+    atomic_store(&s_ring.tail, UINT_MAX - TEST_ITEMS / 2);
+    unsigned full = 0;
+    unsigned empty = 0;
+    pthread_t producer;
+    pthread_t consumer;
+    CHECK(pthread_create(&consumer, NULL, consumer_thread, &empty) == 0);
+    CHECK(pthread_create(&producer, NULL, producer_thread, &full) == 0);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    CHECK(frame_ring_pop(&s_ring) == NULL);
+
+    printf("frame_ring: %d entries in order, producer found the ring full %u times, consumer empty %u times\n",
+           TEST_ITEMS, full, empty);
+    return 0;
+}
@@ -0,0 +1,23 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Display part of the ESP32-S3-EYE BSP. The display lock is held by a simulated
+ * LVGL task for most of the time, like while it renders and flushes frames.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+
+#define BSP_LCD_H_RES   240
+#define BSP_LCD_V_RES   240
+
+void bsp_display_backlight_on(void);
+bool bsp_display_lock(uint32_t timeout_ms);
+void bsp_display_unlock(void);
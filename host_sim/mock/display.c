@@ -0,0 +1,159 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Display of the ESP32-S3-EYE: the BSP display lock, the display start of eyes_show
+ * and its eyes API. The eye animations only take the lock like the real ones, the
+ * time they render is spent by the simulated LVGL task, which holds the lock
+ * render_ms of every period_ms.
+ */
+
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "bsp/esp-bsp.h"
+#include "show_eyes.h"
+#include "eyes_display.h"
+#include "esp_timer.h"
+#include "sim.h"
+
+static struct {
+    pthread_mutex_t lock;       // The display lock
+    pthread_mutex_t stats_lock;
+    pthread_t lvgl;
+    sim_display_config_t config;
+    sim_display_stats_t stats;
+    uint32_t duration_ms;       // Of the animation the eyes play
+} s_disp = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .stats_lock = PTHREAD_MUTEX_INITIALIZER,
+    .config = {
+        .render_ms = 30,
+        .period_ms = 40,
+    },
+};
+
+static void sleep_ms(int ms)
+{
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000 };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+static void *lvgl_task(void *arg)
+{
+    (void)arg;
+    while (1) {
+        pthread_mutex_lock(&s_disp.lock);
+        sleep_ms(s_disp.config.render_ms);
+        pthread_mutex_unlock(&s_disp.lock);
+        sleep_ms(s_disp.config.period_ms - s_disp.config.render_ms);
+    }
+    return NULL;
+}
+
+void sim_display_config(const sim_display_config_t *config)
+{
+    s_disp.config = *config;
+}
+
+void sim_display_stats(sim_display_stats_t *out)
+{
+    pthread_mutex_lock(&s_disp.stats_lock);
+    *out = s_disp.stats;
+    pthread_mutex_unlock(&s_disp.stats_lock);
+}
+
+lv_disp_t *eyes_display_start(void)
+{
+    static int disp;
+    if (pthread_create(&s_disp.lvgl, NULL, lvgl_task, NULL) != 0) {
+        return NULL;
+    }
+    return (lv_disp_t *)&disp;
+}
+
+void bsp_display_backlight_on(void)
+{
+}
+
+bool bsp_display_lock(uint32_t timeout_ms)
+{
+    bool callback = sim_uvc_in_callback();
+    int64_t start_us = esp_timer_get_time();
+    bool locked;
+    if (timeout_ms == 0) {
+        locked = pthread_mutex_lock(&s_disp.lock) == 0;
+    } else {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        locked = pthread_mutex_timedlock(&s_disp.lock, &deadline) == 0;
+    }
+    int64_t wait_us = esp_timer_get_time() - start_us;
+
+    pthread_mutex_lock(&s_disp.stats_lock);
+    s_disp.stats.locks++;
+    if (callback) {
+        s_disp.stats.callback_locks++;
+    }
+    if (wait_us > s_disp.stats.max_wait_us) {
+        s_disp.stats.max_wait_us = wait_us;
+    }
+    pthread_mutex_unlock(&s_disp.stats_lock);
+    return locked;
+}
+
+void bsp_display_unlock(void)
+{
+    pthread_mutex_unlock(&s_disp.lock);
+}
+
+// Changes the eyes under the lock like eyes_show, one loop takes frames * 40 ms
+static lv_obj_t *eyes_show(lv_obj_t *img, uint32_t duration_ms)
+{
+    bsp_display_lock(0);
+    s_disp.duration_ms = duration_ms;
+    bsp_display_unlock();
+    return img;
+}
+
+lv_obj_t *eyes_init(void)
+{
+    static int img;
+    return (lv_obj_t *)&img;
+}
+
+lv_obj_t *eyes_open(lv_obj_t *img)
+{
+    return eyes_show(img, 70 * 40);
+}
+
+lv_obj_t *eyes_blink(lv_obj_t *img)
+{
+    return eyes_show(img, 80 * 40);
+}
+
+lv_obj_t *eyes_close(lv_obj_t *img)
+{
+    return eyes_show(img, 75 * 40);
+}
+
+lv_obj_t *eyes_static(lv_obj_t *img)
+{
+    return eyes_show(img, 0);
+}
+
+uint32_t eyes_duration_ms(lv_obj_t *img)
+{
+    (void)img;
+    return s_disp.duration_ms;
+}
@@ -0,0 +1,483 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <assert.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include "esp_camera.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sim.h"
+
+static const char *TAG = "sim_camera";
+
+// Same timeout as the driver, esp_camera_fb_get() returns NULL after it
+#define FB_GET_TIMEOUT_MS       4000
+#define FB_MAX_COUNT            8
+
+// Registers the pipeline reads back, bit 8 selects the OV2640 sensor bank
+#define SENSOR_REGS             0x4000
+#define OV2640_COM2             0x109
+#define OV2640_COM2_STANDBY     0x10
+
+const resolution_info_t resolution[FRAMESIZE_INVALID] = {
+    {   96,   96 },
+    {  160,  120 },
+    {  128,  128 },
+    {  176,  144 },
+    {  240,  176 },
+    {  240,  240 },
+    {  320,  240 },
+    {  320,  320 },
+    {  400,  296 },
+    {  480,  320 },
+    {  640,  480 },
+    {  800,  600 },
+    { 1024,  768 },
+    { 1280,  720 },
+    { 1280, 1024 },
+    { 1600, 1200 },
+    { 1920, 1080 },
+};
+
+typedef enum {
+    FB_FREE,
+    FB_QUEUED,  // Filled by the sensor, waiting for esp_camera_fb_get()
+    FB_HELD,    // Taken by the application
+} fb_state_t;
+
+static camera_sensor_info_t s_sensor_info = {
+    .name = "OV2640 (simulated)",
+    .sccb_addr = 0x30,
+    .pid = OV2640_PID,
+    .max_size = FRAMESIZE_UXGA,
+    .support_jpeg = true,
+};
+
+static struct {
+    uint8_t **data;
+    size_t *len;
+    int count;
+    size_t max_len;
+} s_files;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t queued;
+    pthread_t thread;
+    volatile bool run;
+    bool inited;
+    int fps;
+    camera_config_t config;
+    camera_fb_t fb[FB_MAX_COUNT];
+    fb_state_t state[FB_MAX_COUNT];
+    int queue[FB_MAX_COUNT];    // Queued buffers, oldest first
+    int queue_len;
+    size_t buf_size;
+    uint16_t out_width;
+    uint16_t out_height;
+    uint32_t next_file;
+    unsigned int seed;
+    sensor_t sensor;
+    uint8_t regs[SENSOR_REGS];
+    sim_camera_stats_t stats;
+} s_cam = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .queued = PTHREAD_COND_INITIALIZER,
+    .fps = 30,
+    .seed = 1,
+};
+
+static int name_cmp(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static bool is_jpeg_name(const char *name)
+{
+    const char *dot = strrchr(name, '.');
+    return dot && (strcasecmp(dot, ".jpg") == 0 || strcasecmp(dot, ".jpeg") == 0);
+}
+
+// Read every JPEG of the directory, in name order so that runs are reproducible
+static esp_err_t files_load(const char *dir)
+{
+    DIR *d = opendir(dir);
+    if (!d) {
+        ESP_LOGE(TAG, "Cannot open %s: %s", dir, strerror(errno));
+        return ESP_ERR_NOT_FOUND;
+    }
+    char **names = NULL;
+    int count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (!is_jpeg_name(entry->d_name)) {
+            continue;
+        }
+        names = realloc(names, (count + 1) * sizeof(*names));
+        names[count++] = strdup(entry->d_name);
+    }
+    closedir(d);
+    if (count == 0) {
+        ESP_LOGE(TAG, "No .jpg file in %s", dir);
+        free(names);
+        return ESP_ERR_NOT_FOUND;
+    }
+    qsort(names, count, sizeof(*names), name_cmp);
+
+    s_files.data = calloc(count, sizeof(*s_files.data));
+    s_files.len = calloc(count, sizeof(*s_files.len));
+    for (int i = 0; i < count; i++) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+        FILE *f = fopen(path, "rb");
+        if (f) {
+            fseek(f, 0, SEEK_END);
+            long len = ftell(f);
+            fseek(f, 0, SEEK_SET);
+            s_files.data[s_files.count] = malloc(len > 0 ? len : 1);
+            if (len > 0 && fread(s_files.data[s_files.count], 1, len, f) == (size_t)len) {
+                s_files.len[s_files.count] = len;
+                if ((size_t)len > s_files.max_len) {
+                    s_files.max_len = len;
+                }
+                s_files.count++;
+            } else {
+                free(s_files.data[s_files.count]);
+            }
+            fclose(f);
+        }
+        free(names[i]);
+    }
+    free(names);
+    if (s_files.count == 0) {
+        ESP_LOGE(TAG, "No readable .jpg file in %s", dir);
+        return ESP_ERR_NOT_FOUND;
+    }
+    ESP_LOGI(TAG, "Playing %d JPEG files from %s, largest %zu bytes", s_files.count, dir, s_files.max_len);
+    return ESP_OK;
+}
+
+esp_err_t sim_camera_config(const sim_camera_config_t *config)
+{
+    s_cam.fps = config->fps > 0 ? config->fps : 30;
+    if (config->frames_dir) {
+        return files_load(config->frames_dir);
+    }
+    return ESP_OK;
+}
+
+void sim_camera_stats(sim_camera_stats_t *out)
+{
+    pthread_mutex_lock(&s_cam.lock);
+    *out = s_cam.stats;
+    pthread_mutex_unlock(&s_cam.lock);
+}
+
+// Size of a synthetic JPEG, roughly what an OV2640 produces for an indoor scene
+static size_t synthetic_jpeg_len(void)
+{
+    size_t pixels = (size_t)s_cam.out_width * s_cam.out_height;
+    size_t len = pixels / (s_cam.sensor.status.quality / 2 + 2);
+    // +-12% of scene noise
+    len = len * (88 + rand_r(&s_cam.seed) % 25) / 100;
+    return len < s_cam.buf_size ? len : s_cam.buf_size;
+}
+
+// Produce one frame into a driver buffer, called with the lock held
+static void frame_fill(camera_fb_t *fb)
+{
+    if (s_cam.config.pixel_format == PIXFORMAT_JPEG) {
+        if (s_files.count) {
+            int i = s_cam.next_file++ % s_files.count;
+            fb->len = s_files.len[i];
+            memcpy(fb->buf, s_files.data[i], fb->len);
+        } else {
+            fb->len = synthetic_jpeg_len();
+            memset(fb->buf, (uint8_t)s_cam.stats.frames, fb->len);
+            fb->buf[0] = 0xff;
+            fb->buf[1] = 0xd8;
+            fb->buf[fb->len - 2] = 0xff;
+            fb->buf[fb->len - 1] = 0xd9;
+        }
+    } else {
+        // Same amount of data as the DMA would write, the content does not matter
+        fb->len = (size_t)s_cam.out_width * s_cam.out_height * 2;
+        memset(fb->buf, (uint8_t)s_cam.stats.frames, fb->len);
+    }
+    // The driver reports the frame size it was initialized with, whatever the sensor outputs
+    fb->width = resolution[s_cam.config.frame_size].width;
+    fb->height = resolution[s_cam.config.frame_size].height;
+    fb->format = s_cam.config.pixel_format;
+    int64_t now_us = esp_timer_get_time();
+    fb->timestamp.tv_sec = now_us / 1000000;
+    fb->timestamp.tv_usec = now_us % 1000000;
+}
+
+static void sensor_frame(void)
+{
+    int slot = -1;
+    for (int i = 0; i < (int)s_cam.config.fb_count; i++) {
+        if (s_cam.state[i] == FB_FREE) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0 && s_cam.config.grab_mode == CAMERA_GRAB_LATEST && s_cam.queue_len > 0) {
+        // The driver overwrites the oldest queued frame
+        slot = s_cam.queue[0];
+        memmove(&s_cam.queue[0], &s_cam.queue[1], (s_cam.queue_len - 1) * sizeof(s_cam.queue[0]));
+        s_cam.queue_len--;
+        s_cam.stats.replaced++;
+    }
+    s_cam.stats.frames++;
+    if (s_cam.config.pixel_format != PIXFORMAT_JPEG
+            && (s_cam.out_width != resolution[s_cam.config.frame_size].width
+                || s_cam.out_height != resolution[s_cam.config.frame_size].height)) {
+        // Like cam_hal, a raw frame of another length than the one set at init is dropped
+        s_cam.stats.mismatched++;
+        return;
+    }
+    if (slot < 0) {
+        // No buffer for the DMA, the frame is lost
+        s_cam.stats.overruns++;
+        return;
+    }
+    frame_fill(&s_cam.fb[slot]);
+    s_cam.state[slot] = FB_QUEUED;
+    s_cam.queue[s_cam.queue_len++] = slot;
+    pthread_cond_signal(&s_cam.queued);
+}
+
+static void *sensor_task(void *arg)
+{
+    (void)arg;
+    int64_t interval_us = 1000000 / s_cam.fps;
+    int64_t next_us = esp_timer_get_time() + interval_us;
+    while (s_cam.run) {
+        int64_t wait_us = next_us - esp_timer_get_time();
+        if (wait_us > 0) {
+            struct timespec ts = { .tv_sec = wait_us / 1000000, .tv_nsec = (wait_us % 1000000) * 1000 };
+            nanosleep(&ts, NULL);
+        }
+        next_us += interval_us;
+        pthread_mutex_lock(&s_cam.lock);
+        if (!(s_cam.regs[OV2640_COM2] & OV2640_COM2_STANDBY)) {
+            sensor_frame();
+        }
+        pthread_mutex_unlock(&s_cam.lock);
+    }
+    return NULL;
+}
+
+static int set_framesize(sensor_t *s, framesize_t framesize)
+{
+    // The buffers are sized for the frame size the driver was initialized with
+    if (framesize > s_cam.config.frame_size) {
+        return -1;
+    }
+    pthread_mutex_lock(&s_cam.lock);
+    s->status.framesize = framesize;
+    s_cam.out_width = resolution[framesize].width;
+    s_cam.out_height = resolution[framesize].height;
+    pthread_mutex_unlock(&s_cam.lock);
+    return 0;
+}
+
+static int set_res_raw(sensor_t *s, int startX, int startY, int endX, int endY, int offsetX, int offsetY,
+                       int totalX, int totalY, int outputX, int outputY, bool scale, bool binning)
+{
+    (void)startX, (void)startY, (void)endX, (void)endY, (void)offsetX, (void)offsetY;
+    (void)totalX, (void)totalY, (void)scale, (void)binning;
+    if ((size_t)outputX * outputY > (size_t)resolution[s_cam.config.frame_size].width * resolution[s_cam.config.frame_size].height) {
+        return -1;
+    }
+    pthread_mutex_lock(&s_cam.lock);
+    s_cam.out_width = outputX;
+    s_cam.out_height = outputY;
+    pthread_mutex_unlock(&s_cam.lock);
+    (void)s;
+    return 0;
+}
+
+static int get_reg(sensor_t *s, int reg, int mask)
+{
+    (void)s;
+    return s_cam.regs[reg % SENSOR_REGS] & mask;
+}
+
+static int set_reg(sensor_t *s, int reg, int mask, int value)
+{
+    (void)s;
+    pthread_mutex_lock(&s_cam.lock);
+    uint8_t *r = &s_cam.regs[reg % SENSOR_REGS];
+    *r = (*r & ~mask) | (value & mask);
+    pthread_mutex_unlock(&s_cam.lock);
+    return 0;
+}
+
+#define STATUS_SETTER(name, field) \
+    static int name(sensor_t *s, int value) { s->status.field = value; return 0; }
+
+STATUS_SETTER(set_quality, quality)
+STATUS_SETTER(set_brightness, brightness)
+STATUS_SETTER(set_contrast, contrast)
+STATUS_SETTER(set_saturation, saturation)
+STATUS_SETTER(set_sharpness, sharpness)
+STATUS_SETTER(set_whitebal, awb)
+STATUS_SETTER(set_wb_mode, wb_mode)
+STATUS_SETTER(set_exposure_ctrl, aec)
+STATUS_SETTER(set_aec_value, aec_value)
+STATUS_SETTER(set_gain_ctrl, agc)
+STATUS_SETTER(set_agc_gain, agc_gain)
+STATUS_SETTER(set_hmirror, hmirror)
+STATUS_SETTER(set_vflip, vflip)
+
+esp_err_t esp_camera_init(const camera_config_t *config)
+{
+    if (s_cam.inited || config->fb_count == 0 || config->fb_count > FB_MAX_COUNT || config->frame_size >= FRAMESIZE_INVALID) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t pixels = (size_t)resolution[config->frame_size].width * resolution[config->frame_size].height;
+    s_cam.config = *config;
+    if (config->pixel_format != PIXFORMAT_JPEG) {
+        s_cam.buf_size = pixels * 2;
+    } else if (s_files.count) {
+        s_cam.buf_size = s_files.max_len;
+    } else {
+        s_cam.buf_size = pixels / 2;
+    }
+    for (int i = 0; i < (int)config->fb_count; i++) {
+        s_cam.fb[i].buf = malloc(s_cam.buf_size);
+        if (!s_cam.fb[i].buf) {
+            return ESP_ERR_NO_MEM;
+        }
+        s_cam.state[i] = FB_FREE;
+    }
+    s_cam.queue_len = 0;
+    s_cam.out_width = resolution[config->frame_size].width;
+    s_cam.out_height = resolution[config->frame_size].height;
+    memset(s_cam.regs, 0, sizeof(s_cam.regs));
+
+    s_cam.sensor = (sensor_t) {
+        .id = { .MIDH = 0x7f, .MIDL = 0xa2, .PID = OV2640_PID, .VER = 0x42 },
+        .status = {
+            .framesize = config->frame_size,
+            .quality = config->jpeg_quality,
+            .awb = 1,
+            .aec = 1,
+            .agc = 1,
+            .aec_value = 300,
+        },
+        .pixformat = config->pixel_format,
+        .set_framesize = set_framesize,
+        .set_quality = set_quality,
+        .set_brightness = set_brightness,
+        .set_contrast = set_contrast,
+        .set_saturation = set_saturation,
+        .set_sharpness = set_sharpness,
+        .set_whitebal = set_whitebal,
+        .set_wb_mode = set_wb_mode,
+        .set_exposure_ctrl = set_exposure_ctrl,
+        .set_aec_value = set_aec_value,
+        .set_gain_ctrl = set_gain_ctrl,
+        .set_agc_gain = set_agc_gain,
+        .set_hmirror = set_hmirror,
+        .set_vflip = set_vflip,
+        .get_reg = get_reg,
+        .set_reg = set_reg,
+        .set_res_raw = set_res_raw,
+    };
+
+    s_cam.run = true;
+    if (pthread_create(&s_cam.thread, NULL, sensor_task, NULL) != 0) {
+        return ESP_FAIL;
+    }
+    s_cam.inited = true;
+    ESP_LOGD(TAG, "%zu buffers of %zu bytes, sensor at %d fps", config->fb_count, s_cam.buf_size, s_cam.fps);
+    return ESP_OK;
+}
+
+esp_err_t esp_camera_deinit(void)
+{
+    if (!s_cam.inited) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_cam.run = false;
+    pthread_join(s_cam.thread, NULL);
+    for (int i = 0; i < (int)s_cam.config.fb_count; i++) {
+        free(s_cam.fb[i].buf);
+        s_cam.fb[i].buf = NULL;
+    }
+    s_cam.inited = false;
+    return ESP_OK;
+}
+
+camera_fb_t *esp_camera_fb_get(void)
+{
+    if (!s_cam.inited) {
+        return NULL;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += FB_GET_TIMEOUT_MS / 1000;
+
+    camera_fb_t *fb = NULL;
+    pthread_mutex_lock(&s_cam.lock);
+    while (s_cam.queue_len == 0) {
+        if (pthread_cond_timedwait(&s_cam.queued, &s_cam.lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    if (s_cam.queue_len > 0) {
+        int slot = s_cam.queue[0];
+        memmove(&s_cam.queue[0], &s_cam.queue[1], (s_cam.queue_len - 1) * sizeof(s_cam.queue[0]));
+        s_cam.queue_len--;
+        s_cam.state[slot] = FB_HELD;
+        fb = &s_cam.fb[slot];
+    }
+    pthread_mutex_unlock(&s_cam.lock);
+    if (!fb) {
+        ESP_LOGW(TAG, "Failed to get the frame on time!");
+    }
+    return fb;
+}
+
+void esp_camera_fb_return(camera_fb_t *fb)
+{
+    pthread_mutex_lock(&s_cam.lock);
+    int slot = fb - s_cam.fb;
+    assert(slot >= 0 && slot < (int)s_cam.config.fb_count && s_cam.state[slot] == FB_HELD);
+    s_cam.state[slot] = FB_FREE;
+    pthread_mutex_unlock(&s_cam.lock);
+}
+
+void esp_camera_return_all(void)
+{
+    pthread_mutex_lock(&s_cam.lock);
+    for (int i = 0; i < (int)s_cam.config.fb_count; i++) {
+        if (s_cam.state[i] == FB_HELD) {
+            s_cam.state[i] = FB_FREE;
+        }
+    }
+    pthread_mutex_unlock(&s_cam.lock);
+}
+
+sensor_t *esp_camera_sensor_get(void)
+{
+    return s_cam.inited ? &s_cam.sensor : NULL;
+}
+
+camera_sensor_info_t *esp_camera_sensor_get_info(sensor_id_t *id)
+{
+    return id->PID == s_sensor_info.pid ? &s_sensor_info : NULL;
+}
@@ -0,0 +1,31 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "esp_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Debug output is only printed when the simulation runs with --verbose */
+extern int esp_log_verbose;
+
+#define ESP_LOG_SIM(letter, tag, format, ...) \
+    printf(letter " (%" PRId64 ") %s: " format "\n", esp_timer_get_time() / 1000, tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_SIM("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_SIM("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_SIM("I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do { if (esp_log_verbose) ESP_LOG_SIM("D", tag, format, ##__VA_ARGS__); } while (0)
+#define ESP_LOGV(tag, format, ...) ESP_LOGD(tag, format, ##__VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,116 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <jpeglib.h>
+#include "img_converters.h"
+
+#define OUT_CHUNK   1024
+
+typedef struct {
+    struct jpeg_destination_mgr mgr;
+    jpg_out_cb cb;
+    void *arg;
+    size_t index;
+    bool failed;
+    JOCTET buf[OUT_CHUNK];
+} out_dest_t;
+
+static void out_init(j_compress_ptr cinfo)
+{
+    out_dest_t *dest = (out_dest_t *)cinfo->dest;
+    dest->mgr.next_output_byte = dest->buf;
+    dest->mgr.free_in_buffer = OUT_CHUNK;
+}
+
+// Hands the output over in chunks, like the esp32-camera encoder does
+static void out_flush(out_dest_t *dest, size_t len)
+{
+    if (len && dest->cb(dest->arg, dest->index, dest->buf, len) != len) {
+        dest->failed = true;
+    }
+    dest->index += len;
+}
+
+static boolean out_empty(j_compress_ptr cinfo)
+{
+    out_dest_t *dest = (out_dest_t *)cinfo->dest;
+    out_flush(dest, OUT_CHUNK);
+    out_init(cinfo);
+    return TRUE;
+}
+
+static void out_term(j_compress_ptr cinfo)
+{
+    out_dest_t *dest = (out_dest_t *)cinfo->dest;
+    out_flush(dest, OUT_CHUNK - dest->mgr.free_in_buffer);
+}
+
+// One row of YUYV to YCbCr, or RGB565 (big endian like the sensor sends it) to RGB
+static void convert_row(const uint8_t *src, uint8_t *row, int width, pixformat_t format)
+{
+    if (format == PIXFORMAT_YUV422) {
+        for (int x = 0; x < width; x += 2, src += 4, row += 6) {
+            row[0] = src[0];
+            row[1] = src[1];
+            row[2] = src[3];
+            row[3] = src[2];
+            row[4] = src[1];
+            row[5] = src[3];
+        }
+    } else {
+        for (int x = 0; x < width; x++, src += 2, row += 3) {
+            uint16_t px = (uint16_t)(src[0] << 8 | src[1]);
+            row[0] = (uint8_t)((px >> 8) & 0xf8);
+            row[1] = (uint8_t)((px >> 3) & 0xfc);
+            row[2] = (uint8_t)((px << 3) & 0xf8);
+        }
+    }
+}
+
+bool fmt2jpg_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality,
+                jpg_out_cb cb, void *arg)
+{
+    if ((format != PIXFORMAT_YUV422 && format != PIXFORMAT_RGB565) || src_len < (size_t)width * height * 2) {
+        return false;
+    }
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    out_dest_t dest = {
+        .mgr = {
+            .init_destination = out_init,
+            .empty_output_buffer = out_empty,
+            .term_destination = out_term,
+        },
+        .cb = cb,
+        .arg = arg,
+    };
+    uint8_t *row = malloc((size_t)width * 3);
+    if (!row) {
+        return false;
+    }
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    cinfo.dest = &dest.mgr;
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = format == PIXFORMAT_YUV422 ? JCS_YCbCr : JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < height) {
+        convert_row(src + (size_t)cinfo.next_scanline * width * 2, row, width, format);
+        JSAMPROW rows[1] = { row };
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    free(row);
+    return !dest.failed;
+}
@@ -0,0 +1,36 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * JPEG encoder entry of esp32-camera used by sw_jpeg.c. The host build implements it
+ * with libjpeg, the encoder of esp32-camera is not part of this tree.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_camera.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef size_t (*jpg_out_cb)(void *arg, size_t index, const void *data, size_t len);
+
+/**
+ * @brief Encode a YUV422 or RGB565 frame, the output is passed to cb as it is produced
+ *
+ * @param quality 1-100, higher is better
+ * @return false if the format is not supported or cb did not take the output
+ */
+bool fmt2jpg_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality,
+                jpg_out_cb cb, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
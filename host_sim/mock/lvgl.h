@@ -0,0 +1,47 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * The part of lvgl.h the image sources of eyes_show need, so that the benchmark can
+ * read the GIFs they embed, and the opaque types of the display API.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define LV_COLOR_DEPTH              16
+#define LV_COLOR_SIZE               16
+#define LV_ATTRIBUTE_LARGE_CONST
+
+enum {
+    LV_IMG_CF_UNKNOWN = 0,
+    LV_IMG_CF_RAW,
+    LV_IMG_CF_RAW_ALPHA,
+    LV_IMG_CF_RAW_CHROMA_KEYED,
+    LV_IMG_CF_TRUE_COLOR,
+    LV_IMG_CF_TRUE_COLOR_ALPHA,
+    LV_IMG_CF_TRUE_COLOR_CHROMA_KEYED,
+};
+
+typedef struct {
+    uint32_t cf : 5;
+    uint32_t always_zero : 3;
+    uint32_t reserved : 2;
+    uint32_t w : 11;
+    uint32_t h : 11;
+} lv_img_header_t;
+
+typedef struct {
+    lv_img_header_t header;
+    uint32_t data_size;
+    const uint8_t *data;
+} lv_img_dsc_t;
+
+typedef struct _lv_obj_t lv_obj_t;
+typedef struct _lv_disp_t lv_disp_t;
+
+#define LV_IMG_DECLARE(var_name) extern const lv_img_dsc_t var_name;
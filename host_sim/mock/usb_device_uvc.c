@@ -0,0 +1,263 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "usb_device_uvc.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sim.h"
+
+static const char *TAG = "sim_uvc";
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t control;
+    pthread_t video;
+    uvc_device_config_t config;
+    sim_uvc_config_t host;
+    volatile bool run;
+    volatile bool streaming;
+    bool started;
+    bool start_failed;
+    int64_t start_us;
+    sim_uvc_stats_t stats;
+} s_uvc = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .host = {
+        .format = UVC_FORMAT_MJPEG,
+        .width = 640,
+        .height = 480,
+        .fps = 30,
+        .kbps = SIM_USB_ISOC_KBPS,
+        .enumeration_ms = 500,
+    },
+};
+
+// Set on a host thread while it runs a callback of the application
+static __thread bool s_in_callback;
+
+static void sleep_us(int64_t us)
+{
+    if (us <= 0) {
+        return;
+    }
+    struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000 };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+static void started_set(bool ok)
+{
+    pthread_mutex_lock(&s_uvc.lock);
+    s_uvc.started = true;
+    s_uvc.start_failed = !ok;
+    pthread_cond_broadcast(&s_uvc.cond);
+    pthread_mutex_unlock(&s_uvc.lock);
+}
+
+static esp_err_t host_start(void)
+{
+    s_in_callback = true;
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = s_uvc.config.start_cb(s_uvc.host.format, s_uvc.host.width, s_uvc.host.height, s_uvc.host.fps,
+                                          s_uvc.config.cb_ctx);
+    int64_t cb_us = esp_timer_get_time() - start_us;
+    s_in_callback = false;
+    pthread_mutex_lock(&s_uvc.lock);
+    if (cb_us > s_uvc.stats.start_cb_max_us) {
+        s_uvc.stats.start_cb_max_us = cb_us;
+    }
+    pthread_mutex_unlock(&s_uvc.lock);
+    return ret;
+}
+
+static void host_stop(void)
+{
+    s_in_callback = true;
+    int64_t start_us = esp_timer_get_time();
+    s_uvc.config.stop_cb(s_uvc.config.cb_ctx);
+    int64_t cb_us = esp_timer_get_time() - start_us;
+    s_in_callback = false;
+    pthread_mutex_lock(&s_uvc.lock);
+    if (cb_us > s_uvc.stats.stop_cb_max_us) {
+        s_uvc.stats.stop_cb_max_us = cb_us;
+    }
+    pthread_mutex_unlock(&s_uvc.lock);
+}
+
+// Stream start, restarts and stop, like the commit and set interface requests that reach the
+// callbacks on the TinyUSB task while the video task keeps running
+static void *control_task(void *arg)
+{
+    (void)arg;
+    sleep_us((int64_t)s_uvc.host.enumeration_ms * 1000);
+    esp_err_t ret = host_start();
+    s_uvc.start_us = esp_timer_get_time();
+    s_uvc.streaming = ret == ESP_OK;
+    started_set(ret == ESP_OK);
+    if (ret != ESP_OK) {
+        return NULL;
+    }
+    int64_t restart_us = s_uvc.start_us + (int64_t)s_uvc.host.restart_ms * 1000;
+    while (s_uvc.run) {
+        if (!s_uvc.host.restart_ms || esp_timer_get_time() < restart_us) {
+            sleep_us(1000);
+            continue;
+        }
+        // Like a host application closing and reopening the camera, the video task may be in a
+        // callback meanwhile
+        s_uvc.streaming = false;
+        host_stop();
+        if (s_uvc.host.alt_width) {
+            // Swap to the other frame size
+            pthread_mutex_lock(&s_uvc.lock);
+            int width = s_uvc.host.width, height = s_uvc.host.height, fps = s_uvc.host.fps;
+            s_uvc.host.width = s_uvc.host.alt_width;
+            s_uvc.host.height = s_uvc.host.alt_height;
+            s_uvc.host.fps = s_uvc.host.alt_fps;
+            s_uvc.host.alt_width = width;
+            s_uvc.host.alt_height = height;
+            s_uvc.host.alt_fps = fps;
+            pthread_mutex_unlock(&s_uvc.lock);
+        }
+        if (host_start() != ESP_OK) {
+            ESP_LOGE(TAG, "Stream restart failed");
+            return NULL;
+        }
+        s_uvc.streaming = true;
+        pthread_mutex_lock(&s_uvc.lock);
+        s_uvc.stats.restarts++;
+        pthread_mutex_unlock(&s_uvc.lock);
+        restart_us = esp_timer_get_time() + (int64_t)s_uvc.host.restart_ms * 1000;
+    }
+    s_uvc.streaming = false;
+    host_stop();
+    return NULL;
+}
+
+// One frame per interval like the component, the transfer holds the bus for len / bandwidth
+static void *video_task(void *arg)
+{
+    (void)arg;
+    int64_t next_us = 0;
+    while (s_uvc.run) {
+        int64_t now_us = esp_timer_get_time();
+        if (!s_uvc.streaming) {
+            sleep_us(1000);
+            next_us = 0;
+            continue;
+        }
+        if (now_us < next_us) {
+            sleep_us(next_us - now_us < 1000 ? next_us - now_us : 1000);
+            continue;
+        }
+        s_in_callback = true;
+        uvc_fb_t *fb = s_uvc.config.fb_get_cb(s_uvc.config.cb_ctx);
+        s_in_callback = false;
+        if (!fb) {
+            continue;
+        }
+        pthread_mutex_lock(&s_uvc.lock);
+        int64_t interval_us = 1000000 / s_uvc.host.fps;
+        pthread_mutex_unlock(&s_uvc.lock);
+        next_us = (next_us ? next_us : now_us) + interval_us;
+        if (next_us < now_us) {
+            next_us = now_us;
+        }
+
+        // The application may reallocate the transfer buffer in start_cb, read it every frame
+        size_t len = fb->len;
+        bool fits = len <= s_uvc.config.uvc_buffer_size;
+        if (fits) {
+            memcpy(s_uvc.config.uvc_buffer, fb->buf, len);
+        }
+        s_in_callback = true;
+        s_uvc.config.fb_return_cb(fb, s_uvc.config.cb_ctx);
+        s_in_callback = false;
+        if (!fits) {
+            ESP_LOGE(TAG, "Frame of %zu bytes exceeds the %"PRIu32" byte transfer buffer", len, s_uvc.config.uvc_buffer_size);
+            pthread_mutex_lock(&s_uvc.lock);
+            s_uvc.stats.oversize++;
+            pthread_mutex_unlock(&s_uvc.lock);
+            continue;
+        }
+
+        int64_t xfer_us = (int64_t)len * 1000000 / ((int64_t)s_uvc.host.kbps * 1024);
+        sleep_us(xfer_us);
+        pthread_mutex_lock(&s_uvc.lock);
+        s_uvc.stats.frames++;
+        s_uvc.stats.bytes += len;
+        s_uvc.stats.busy_us += xfer_us;
+        pthread_mutex_unlock(&s_uvc.lock);
+    }
+    return NULL;
+}
+
+void sim_uvc_config(const sim_uvc_config_t *config)
+{
+    s_uvc.host = *config;
+}
+
+bool sim_uvc_wait_started(void)
+{
+    pthread_mutex_lock(&s_uvc.lock);
+    while (!s_uvc.started) {
+        pthread_cond_wait(&s_uvc.cond, &s_uvc.lock);
+    }
+    bool ok = !s_uvc.start_failed;
+    pthread_mutex_unlock(&s_uvc.lock);
+    return ok;
+}
+
+void sim_uvc_stop(void)
+{
+    s_uvc.run = false;
+    pthread_join(s_uvc.video, NULL);
+    pthread_join(s_uvc.control, NULL);
+}
+
+bool sim_uvc_in_callback(void)
+{
+    return s_in_callback;
+}
+
+void sim_uvc_stats(sim_uvc_stats_t *out)
+{
+    pthread_mutex_lock(&s_uvc.lock);
+    *out = s_uvc.stats;
+    out->stream_us = s_uvc.start_us ? esp_timer_get_time() - s_uvc.start_us : 0;
+    pthread_mutex_unlock(&s_uvc.lock);
+}
+
+esp_err_t uvc_device_config(int index, uvc_device_config_t *config)
+{
+    if (index != 0 || !config->start_cb || !config->fb_get_cb || !config->fb_return_cb || !config->stop_cb
+            || !config->uvc_buffer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_uvc.config = *config;
+    return ESP_OK;
+}
+
+esp_err_t uvc_device_init(void)
+{
+    if (!s_uvc.config.start_cb) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_uvc.run = true;
+    if (pthread_create(&s_uvc.control, NULL, control_task, NULL) != 0
+            || pthread_create(&s_uvc.video, NULL, video_task, NULL) != 0) {
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Host negotiates %dx%d @%d fps over %d KB/s", s_uvc.host.width, s_uvc.host.height,
+             s_uvc.host.fps, s_uvc.host.kbps);
+    return ESP_OK;
+}
@@ -0,0 +1,59 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * usb_device_uvc API subset used by the webcam. The simulated host negotiates one mode
+ * and drains frames at a fixed USB bandwidth, see sim.h.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    UVC_FORMAT_MJPEG = 1,
+    UVC_FORMAT_YUY2,
+    UVC_FORMAT_NV12,
+    UVC_FORMAT_GRAY8,
+} uvc_format_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t width;
+    size_t height;
+    uvc_format_t format;
+    struct timeval timestamp;
+} uvc_fb_t;
+
+typedef esp_err_t (*uvc_input_start_cb_t)(uvc_format_t format, int width, int height, int rate, void *cb_ctx);
+typedef uvc_fb_t *(*uvc_input_fb_get_cb_t)(void *cb_ctx);
+typedef void (*uvc_input_fb_return_cb_t)(uvc_fb_t *fb, void *cb_ctx);
+typedef void (*uvc_input_stop_cb_t)(void *cb_ctx);
+
+typedef struct {
+    uint8_t *uvc_buffer;
+    uint32_t uvc_buffer_size;
+    uvc_input_start_cb_t start_cb;
+    uvc_input_fb_get_cb_t fb_get_cb;
+    uvc_input_fb_return_cb_t fb_return_cb;
+    uvc_input_stop_cb_t stop_cb;
+    void *cb_ctx;
+} uvc_device_config_t;
+
+esp_err_t uvc_device_config(int index, uvc_device_config_t *config);
+esp_err_t uvc_device_init(void);
+
+#ifdef __cplusplus
+}
+#endif
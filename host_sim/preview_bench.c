@@ -0,0 +1,258 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Cost of scaling a camera frame down to the LCD preview.
+ *
+ * JPEG frames are scaled with the DC-only decoder of preview_scale.c and, for
+ * comparison, with libjpeg: a full decode followed by the same nearest neighbour
+ * downscale, and libjpeg's own 1/8 scaled decode. Frames are read from the files
+ * given on the command line, e.g. recorded with the host simulation, or else
+ * generated: a synthetic scene encoded with the 4:2:2 sampling of the OV2640.
+ * The difference to libjpeg's 1/8 decode is reported as a sanity check.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <jpeglib.h>
+#include "preview_scale.h"
+
+// Size of the ESP32-S3-EYE LCD
+#define PREVIEW_W       240
+#define PREVIEW_H       240
+#define BENCH_MIN_NS    500000000LL
+
+typedef struct {
+    const char *name;
+    uint8_t *data;
+    size_t len;
+} bench_jpeg_t;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Gradients, a few hard edges and sensor noise, roughly the entropy of an indoor scene
+static uint8_t *synthetic_rgb(int width, int height)
+{
+    uint8_t *rgb = malloc((size_t)width * height * 3);
+    uint32_t seed = 12345;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            seed = seed * 1103515245 + 12345;
+            int noise = (int)((seed >> 16) & 7) - 4;
+            int r = x * 255 / width;
+            int g = y * 255 / height;
+            int b = 128 + ((x / 40 + y / 40) & 1) * 64;
+            if ((x - width / 3) * (x - width / 3) + (y - height / 2) * (y - height / 2) < height * height / 16) {
+                r = 230;
+                g = 200;
+                b = 40;
+            }
+            uint8_t *p = &rgb[((size_t)y * width + x) * 3];
+            p[0] = (uint8_t)(r + noise < 0 ? 0 : (r + noise > 255 ? 255 : r + noise));
+            p[1] = (uint8_t)(g + noise < 0 ? 0 : (g + noise > 255 ? 255 : g + noise));
+            p[2] = (uint8_t)(b + noise < 0 ? 0 : (b + noise > 255 ? 255 : b + noise));
+        }
+    }
+    return rgb;
+}
+
+static bench_jpeg_t synthetic_jpeg(const char *name, int width, int height, int quality)
+{
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    unsigned char *out = NULL;
+    unsigned long out_len = 0;
+    uint8_t *rgb = synthetic_rgb(width, height);
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &out, &out_len);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    // 4:2:2 like the OV2640
+    cinfo.comp_info[0].h_samp_factor = 2;
+    cinfo.comp_info[0].v_samp_factor = 1;
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = &rgb[(size_t)cinfo.next_scanline * width * 3];
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    free(rgb);
+    return (bench_jpeg_t) {
+        name, out, out_len
+    };
+}
+
+static int read_file(const char *path, bench_jpeg_t *jpeg)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    jpeg->len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    jpeg->data = malloc(jpeg->len);
+    jpeg->name = path;
+    size_t got = fread(jpeg->data, 1, jpeg->len, f);
+    fclose(f);
+    return got == jpeg->len ? 0 : -1;
+}
+
+// libjpeg decode at 1/denom scale, then the nearest neighbour scale of preview_scale
+static void libjpeg_scale(const bench_jpeg_t *jpeg, int denom, preview_image_t *img, uint8_t *rgb)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, jpeg->data, jpeg->len);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = denom;
+    cinfo.dct_method = JDCT_IFAST;
+    jpeg_start_decompress(&cinfo);
+    int w = cinfo.output_width;
+    int h = cinfo.output_height;
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = &rgb[(size_t)cinfo.output_scanline * w * 3];
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+
+    // Same fit as preview_scale, from the block grid
+    uint32_t gw = (w * denom + 7) / 8;
+    uint32_t gh = (h * denom + 7) / 8;
+    if (gw * img->max_height >= gh * img->max_width) {
+        img->width = img->max_width;
+        img->height = gh * img->max_width / gw;
+    } else {
+        img->height = img->max_height;
+        img->width = gw * img->max_height / gh;
+    }
+    for (uint32_t y = 0; y < img->height; y++) {
+        const uint8_t *src = &rgb[(size_t)(y * h / img->height) * w * 3];
+        for (uint32_t x = 0; x < img->width; x++) {
+            const uint8_t *p = &src[(x * w / img->width) * 3];
+            img->pixels[y * img->width + x] = (p[0] >> 3) << 11 | (p[1] >> 2) << 5 | p[2] >> 3;
+        }
+    }
+}
+
+// Mean absolute difference per channel, in 8-bit units
+static double image_diff(const preview_image_t *a, const preview_image_t *b)
+{
+    if (a->width != b->width || a->height != b->height) {
+        return -1;
+    }
+    uint64_t sum = 0;
+    size_t n = (size_t)a->width * a->height;
+    for (size_t i = 0; i < n; i++) {
+        uint16_t p = a->pixels[i];
+        uint16_t q = b->pixels[i];
+        sum += abs((p >> 11) - (q >> 11)) * 8 + abs(((p >> 5) & 63) - ((q >> 5) & 63)) * 4 + abs((p & 31) - (q & 31)) * 8;
+    }
+    return (double)sum / (n * 3);
+}
+
+// Evaluates expr until BENCH_MIN_NS passed, yields us per evaluation
+#define BENCH(expr) ({ \
+    int64_t _start = now_ns(); \
+    int _n = 0; \
+    do { \
+        expr; \
+        _n++; \
+    } while (now_ns() - _start < BENCH_MIN_NS); \
+    (now_ns() - _start) / 1000.0 / _n; \
+})
+
+static void bench_jpeg(const bench_jpeg_t *jpeg)
+{
+    preview_image_t dc = { .pixels = malloc(PREVIEW_W * PREVIEW_H * 2), .max_width = PREVIEW_W, .max_height = PREVIEW_H };
+    preview_image_t ref = dc;
+    ref.pixels = malloc(PREVIEW_W * PREVIEW_H * 2);
+    uint8_t *rgb = malloc(4096 * 4096 * 3);
+
+    if (preview_scale(&dc, PREVIEW_SRC_JPEG, jpeg->data, jpeg->len, 0, 0) != ESP_OK) {
+        printf("%-24s not a baseline JPEG, skipped\n", jpeg->name);
+        goto out;
+    }
+    double dc_us = BENCH(preview_scale(&dc, PREVIEW_SRC_JPEG, jpeg->data, jpeg->len, 0, 0));
+    double full_us = BENCH(libjpeg_scale(jpeg, 1, &ref, rgb));
+    double eighth_us = BENCH(libjpeg_scale(jpeg, 8, &ref, rgb));
+    printf("%-24s %7zu bytes -> %3dx%-3d  DC-only %7.1f us  libjpeg full %8.1f us (%5.1fx)  libjpeg 1/8 %7.1f us (%4.1fx)  diff %.2f\n",
+           jpeg->name, jpeg->len, dc.width, dc.height, dc_us, full_us, full_us / dc_us, eighth_us, eighth_us / dc_us,
+           image_diff(&dc, &ref));
+out:
+    free(dc.pixels);
+    free(ref.pixels);
+    free(rgb);
+}
+
+static void bench_yuyv(int width, int height)
+{
+    preview_image_t img = { .pixels = malloc(PREVIEW_W * PREVIEW_H * 2), .max_width = PREVIEW_W, .max_height = PREVIEW_H };
+    uint8_t *yuyv = malloc((size_t)width * height * 2);
+    for (size_t i = 0; i < (size_t)width * height * 2; i++) {
+        yuyv[i] = (uint8_t)(i * 7);
+    }
+    double us = BENCH(preview_scale(&img, PREVIEW_SRC_YUYV, yuyv, (size_t)width * height * 2, width, height));
+    char name[32];
+    snprintf(name, sizeof(name), "YUYV %dx%d", width, height);
+    printf("%-24s %7d bytes -> %3dx%-3d  nearest %7.1f us\n", name, width * height * 2, img.width, img.height, us);
+    free(img.pixels);
+    free(yuyv);
+}
+
+int main(int argc, char **argv)
+{
+    printf("Scaling to fit %dx%d, average time per frame\n", PREVIEW_W, PREVIEW_H);
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            bench_jpeg_t jpeg;
+            if (read_file(argv[i], &jpeg) != 0) {
+                fprintf(stderr, "cannot read %s\n", argv[i]);
+                return 1;
+            }
+            bench_jpeg(&jpeg);
+            free(jpeg.data);
+        }
+        return 0;
+    }
+    const struct {
+        const char *name;
+        int width;
+        int height;
+    } sizes[] = {
+        { "synthetic 320x240", 320, 240 },
+        { "synthetic 640x480", 640, 480 },
+        { "synthetic 1280x720", 1280, 720 },
+        { "synthetic 1920x1080", 1920, 1080 },
+    };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        bench_jpeg_t jpeg = synthetic_jpeg(sizes[i].name, sizes[i].width, sizes[i].height, 80);
+        bench_jpeg(&jpeg);
+        free(jpeg.data);
+    }
+    bench_yuyv(320, 240);
+    bench_yuyv(160, 120);
+    return 0;
+}
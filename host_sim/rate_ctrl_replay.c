@@ -0,0 +1,259 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Replay of frame size traces through the JPEG quality controller of jpeg_rate_ctrl.c.
+ *
+ * A trace lists the sizes of consecutive JPEG frames captured at the base quality of the
+ * mode, one decimal byte count per line, '#' starts a comment. Without a trace file a
+ * synthetic 720p trace is replayed: a calm scene with busy bursts well over the limit.
+ *
+ * The sensor applies a quality two frames after it was set, and a frame captured at
+ * quality q is sized base_size * base_quality / q, the inverse quantizer scaling the
+ * controller assumes. The run prints the drops without and with the controller and
+ * fails if the controller did not cut the drops of the fixed quality by the expected share,
+ * or if it hunts: a quality change that reverses the previous one within
+ * REPLAY_SETTLE_FRAMES is counted as oscillation, and too many of them fail the run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include "jpeg_rate_ctrl.h"
+
+// HD MJPEG mode of uvc_modes.def and the defaults of the controller options
+#define REPLAY_LIMIT            (160 * 1024)
+#define REPLAY_BASE_QUALITY     16
+#define REPLAY_WORST_QUALITY    40
+#define REPLAY_BUDGET_PERCENT   85
+// Frames between set_quality and the first frame captured with it
+#define REPLAY_SENSOR_DELAY     2
+#define REPLAY_SYNTHETIC_FRAMES 3000
+// The controller must keep at most this share of the drops at fixed quality
+#define REPLAY_MAX_DROP_PERCENT 50
+// Half a second at 30 fps, twice the calm frames the controller waits before improving
+#define REPLAY_SETTLE_FRAMES    16
+// Share of the quality changes allowed to reverse the previous one within REPLAY_SETTLE_FRAMES
+#define REPLAY_MAX_HUNT_PERCENT 10
+
+typedef struct {
+    uint32_t *len;
+    size_t count;
+    size_t cap;
+} trace_t;
+
+static void trace_add(trace_t *t, uint32_t len)
+{
+    if (t->count == t->cap) {
+        t->cap = t->cap ? 2 * t->cap : 1024;
+        t->len = realloc(t->len, t->cap * sizeof(t->len[0]));
+        if (!t->len) {
+            fprintf(stderr, "Out of memory\n");
+            exit(2);
+        }
+    }
+    t->len[t->count++] = len;
+}
+
+static int trace_load(trace_t *t, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        char *end;
+        unsigned long len = strtoul(line, &end, 10);
+        if (end != line) {
+            trace_add(t, (uint32_t)len);
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+// Half a second of motion every 10 s on top of a scene around 60% of the limit
+static void trace_synthetic(trace_t *t)
+{
+    uint32_t seed = 12345;
+    for (int i = 0; i < REPLAY_SYNTHETIC_FRAMES; i++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t noise = (seed >> 16) % (REPLAY_LIMIT / 10);
+        uint32_t len = REPLAY_LIMIT * 6 / 10 + noise;
+        int phase = i % 300;
+        if (phase >= 200 && phase < 215) {
+            len = len * 17 / 10;
+        } else if (phase >= 215 && phase < 260) {
+            len = len * 13 / 10;
+        }
+        trace_add(t, len);
+    }
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options] [trace ...]\n"
+           "  -l, --limit BYTES     frame size limit, the UVC frame budget (default %d)\n"
+           "  -q, --quality Q       base quality of the mode the trace was captured at (default %d)\n"
+           "  -w, --worst Q         worst quality the controller may use (default %d)\n"
+           "  -b, --budget PCT      target frame size in percent of the limit (default %d)\n"
+           "  -d, --max-drops PCT   drops allowed with the controller, in percent of those at fixed quality (default %d)\n"
+           "  -o, --max-hunt PCT    quality changes allowed to reverse the previous one within %d frames (default %d)\n",
+           prog, REPLAY_LIMIT, REPLAY_BASE_QUALITY, REPLAY_WORST_QUALITY, REPLAY_BUDGET_PERCENT,
+           REPLAY_MAX_DROP_PERCENT, REPLAY_SETTLE_FRAMES, REPLAY_MAX_HUNT_PERCENT);
+}
+
+typedef struct {
+    uint32_t limit;
+    int base_quality;
+    int worst_quality;
+    int budget;
+    int max_drop_percent;
+    int max_hunt_percent;
+} replay_config_t;
+
+static int replay(const char *name, const trace_t *t, const replay_config_t *cfg)
+{
+    uint32_t limit = cfg->limit;
+    int base_quality = cfg->base_quality;
+    int worst_quality = cfg->worst_quality;
+    jpeg_rate_ctrl_t ctrl;
+    jpeg_rate_ctrl_init(&ctrl, limit, cfg->budget, base_quality, worst_quality);
+
+    // Quality each of the next frames is captured with
+    int pending[REPLAY_SENSOR_DELAY + 1];
+    for (int i = 0; i <= REPLAY_SENSOR_DELAY; i++) {
+        pending[i] = base_quality;
+    }
+    uint32_t fixed_drops = 0;
+    uint64_t quality_sum = 0;
+    int max_quality = base_quality;
+    // Direction and frame of the last quality change, for the oscillation count
+    int last_quality = base_quality;
+    int last_step = 0;
+    size_t last_change = 0;
+    uint32_t changes = 0;
+    uint32_t hunts = 0;
+    for (size_t i = 0; i < t->count; i++) {
+        if (t->len[i] > limit) {
+            fixed_drops++;
+        }
+        int q = pending[0];
+        memmove(&pending[0], &pending[1], REPLAY_SENSOR_DELAY * sizeof(pending[0]));
+        uint32_t len = (uint32_t)((uint64_t)t->len[i] * base_quality / q);
+        int next = jpeg_rate_ctrl_update(&ctrl, len);
+        pending[REPLAY_SENSOR_DELAY] = next;
+        if (next != last_quality) {
+            int step = next > last_quality ? 1 : -1;
+            if (last_step && step != last_step && i - last_change < REPLAY_SETTLE_FRAMES) {
+                hunts++;
+            }
+            changes++;
+            last_quality = next;
+            last_step = step;
+            last_change = i;
+        }
+        quality_sum += q;
+        if (q > max_quality) {
+            max_quality = q;
+        }
+    }
+
+    printf("%s: %zu frames, limit %"PRIu32" bytes, quality %d..%d\n", name, t->count, limit, base_quality, worst_quality);
+    printf("  fixed quality   %6"PRIu32" drops\n", fixed_drops);
+    printf("  rate control    %6"PRIu32" drops, %"PRIu32" avoided (controller estimate %"PRIu32"), "
+           "quality avg %.1f max %d\n", ctrl.dropped, fixed_drops - ctrl.dropped, ctrl.avoided,
+           t->count ? (double)quality_sum / t->count : 0.0, max_quality);
+    printf("  quality         %6"PRIu32" changes, %"PRIu32" reversed within %d frames\n", changes, hunts,
+           REPLAY_SETTLE_FRAMES);
+
+    int failed = 0;
+    if ((uint64_t)ctrl.dropped * 100 > (uint64_t)fixed_drops * cfg->max_drop_percent) {
+        printf("  FAIL: %"PRIu32" drops, more than %d%% of the %"PRIu32" at fixed quality\n", ctrl.dropped,
+               cfg->max_drop_percent, fixed_drops);
+        failed = 1;
+    }
+    if ((uint64_t)hunts * 100 > (uint64_t)changes * cfg->max_hunt_percent) {
+        printf("  FAIL: quality oscillates, %"PRIu32" of %"PRIu32" changes reversed within %d frames, more than %d%%\n",
+               hunts, changes, REPLAY_SETTLE_FRAMES, cfg->max_hunt_percent);
+        failed = 1;
+    }
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] = {
+        { "limit", required_argument, NULL, 'l' },
+        { "quality", required_argument, NULL, 'q' },
+        { "worst", required_argument, NULL, 'w' },
+        { "budget", required_argument, NULL, 'b' },
+        { "max-drops", required_argument, NULL, 'd' },
+        { "max-hunt", required_argument, NULL, 'o' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+    replay_config_t cfg = {
+        .limit = REPLAY_LIMIT,
+        .base_quality = REPLAY_BASE_QUALITY,
+        .worst_quality = REPLAY_WORST_QUALITY,
+        .budget = REPLAY_BUDGET_PERCENT,
+        .max_drop_percent = REPLAY_MAX_DROP_PERCENT,
+        .max_hunt_percent = REPLAY_MAX_HUNT_PERCENT,
+    };
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "l:q:w:b:d:o:h", options, NULL)) != -1) {
+        switch (opt) {
+        case 'l':
+            cfg.limit = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'q':
+            cfg.base_quality = atoi(optarg);
+            break;
+        case 'w':
+            cfg.worst_quality = atoi(optarg);
+            break;
+        case 'b':
+            cfg.budget = atoi(optarg);
+            break;
+        case 'd':
+            cfg.max_drop_percent = atoi(optarg);
+            break;
+        case 'o':
+            cfg.max_hunt_percent = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (cfg.base_quality < 1) {
+        fprintf(stderr, "Base quality must be at least 1\n");
+        return 2;
+    }
+
+    int failed = 0;
+    if (optind == argc) {
+        trace_t t = { 0 };
+        trace_synthetic(&t);
+        failed |= replay("synthetic 720p", &t, &cfg);
+        free(t.len);
+    }
+    for (int i = optind; i < argc; i++) {
+        trace_t t = { 0 };
+        if (trace_load(&t, argv[i]) != 0) {
+            return 2;
+        }
+        failed |= replay(argv[i], &t, &cfg);
+        free(t.len);
+    }
+    return failed;
+}
@@ -0,0 +1,88 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Configuration of the host simulation, the counterpart of the generated sdkconfig.h.
+ * Every option can be overridden from the command line, e.g.
+ * cmake -DCMAKE_C_FLAGS="-DCONFIG_CAMERA_FB_COUNT=3 -DCONFIG_CAMERA_PROFILE_LOW_LATENCY=1"
+ */
+
+#pragma once
+
+#define CONFIG_IDF_TARGET_ESP32S3 1
+#define CONFIG_CAMERA_MODULE_ESP_S3_EYE 1
+
+#ifndef CONFIG_CAMERA_XCLK_FREQ
+#define CONFIG_CAMERA_XCLK_FREQ 20000000
+#endif
+#if !CONFIG_CAMERA_PROFILE_LOW_LATENCY
+#define CONFIG_CAMERA_PROFILE_SMOOTH 1
+#endif
+#ifndef CONFIG_CAMERA_FB_COUNT
+#define CONFIG_CAMERA_FB_COUNT 2
+#endif
+#ifndef CONFIG_CAMERA_FRAME_RATE_PACING
+#define CONFIG_CAMERA_FRAME_RATE_PACING 1
+#endif
+#define CONFIG_CAMERA_CAPTURE_TASK_CORE 1
+#define CONFIG_CAMERA_CAPTURE_TASK_PRIORITY 6
+#ifndef CONFIG_CAMERA_JPEG_RATE_CTRL
+#define CONFIG_CAMERA_JPEG_RATE_CTRL 1
+#endif
+#define CONFIG_CAMERA_JPEG_RATE_CTRL_BUDGET 85
+#define CONFIG_CAMERA_JPEG_RATE_CTRL_WORST_QUALITY 40
+#ifndef CONFIG_CAMERA_WARMUP
+#define CONFIG_CAMERA_WARMUP 1
+#endif
+#ifndef CONFIG_CAMERA_STANDBY
+#define CONFIG_CAMERA_STANDBY 1
+#endif
+#ifndef CONFIG_CAMERA_LCD_EYES
+#define CONFIG_CAMERA_LCD_EYES 1
+#endif
+/* Software JPEG and NVS need ESP-IDF components that are not mocked */
+#define CONFIG_CAMERA_SW_JPEG 0
+#define CONFIG_CAMERA_STORE 0
+
+#define CONFIG_UVC_BUFFER_INTERNAL_MAX 192
+#define CONFIG_UVC_BUFFER_INTERNAL_RESERVE 48
+
+/*
+ * Without a usb_device_uvc format option the simulated host negotiates every format.
+ * -DCONFIG_FORMAT_MJPEG_CAM1=1 advertises the MJPEG frames of sdkconfig.defaults only,
+ * like the device, and sizes the buffers the same way.
+ */
+#if CONFIG_FORMAT_MJPEG_CAM1
+#define CONFIG_UVC_CAM1_FRAMESIZE_WIDTH 640
+#define CONFIG_UVC_CAM1_FRAMESIZE_HEIGT 480
+#define CONFIG_UVC_CAM1_FRAMERATE 30
+#define CONFIG_UVC_CAM1_MULTI_FRAMESIZE 1
+#define CONFIG_UVC_MULTI_FRAME_WIDTH_1 320
+#define CONFIG_UVC_MULTI_FRAME_HEIGHT_1 240
+#define CONFIG_UVC_MULTI_FRAME_FPS_1 30
+#define CONFIG_UVC_MULTI_FRAME_WIDTH_2 480
+#define CONFIG_UVC_MULTI_FRAME_HEIGHT_2 320
+#define CONFIG_UVC_MULTI_FRAME_FPS_2 30
+#define CONFIG_UVC_MULTI_FRAME_WIDTH_3 1280
+#define CONFIG_UVC_MULTI_FRAME_HEIGHT_3 720
+#define CONFIG_UVC_MULTI_FRAME_FPS_3 15
+#endif
+#define CONFIG_UVC_MODE_MJPEG_VGA 1
+#define CONFIG_UVC_MODE_MJPEG_QVGA 1
+#define CONFIG_UVC_MODE_MJPEG_HVGA 1
+#define CONFIG_UVC_MODE_MJPEG_HD 1
+#define CONFIG_UVC_MODE_YUY2_QVGA 1
+#define CONFIG_UVC_MODE_YUY2_240X240 1
+#define CONFIG_UVC_MODE_YUY2_QCIF 1
+#define CONFIG_UVC_MODE_YUY2_QQVGA 1
+#define CONFIG_UVC_MODE_GRAY8_VGA 1
+#define CONFIG_UVC_MODE_GRAY8_HVGA 1
+#define CONFIG_UVC_MODE_GRAY8_QVGA 1
+#define CONFIG_UVC_MODE_GRAY8_QQVGA 1
+#define CONFIG_UVC_MODE_NV12_VGA 1
+#define CONFIG_UVC_MODE_NV12_HVGA 1
+#define CONFIG_UVC_MODE_NV12_QVGA 1
+#define CONFIG_UVC_MODE_NV12_QQVGA 1
@@ -0,0 +1,128 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usb_device_uvc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* USB throughput of the two transfer modes, see the table in the README */
+#define SIM_USB_ISOC_KBPS       512
+#define SIM_USB_BULK_KBPS       1216
+
+/**
+ * @brief Simulated sensor
+ */
+typedef struct {
+    const char *frames_dir;     /*!< Directory of recorded .jpg files, NULL for synthetic frames */
+    int fps;                    /*!< Frames the sensor delivers per second */
+} sim_camera_config_t;
+
+/**
+ * @brief What the simulated sensor did, the pipeline never sees these frames
+ */
+typedef struct {
+    uint32_t frames;            /*!< Frames the sensor produced */
+    uint32_t overruns;          /*!< Frames lost because every driver buffer was queued or lent out */
+    uint32_t replaced;          /*!< Queued frames overwritten by a newer one (CAMERA_GRAB_LATEST) */
+    uint32_t mismatched;        /*!< Raw frames dropped because the sensor output another size than set at init */
+} sim_camera_stats_t;
+
+/**
+ * @brief Simulated USB host
+ */
+typedef struct {
+    uvc_format_t format;        /*!< Format the host negotiates */
+    int width;                  /*!< Frame width the host negotiates */
+    int height;                 /*!< Frame height the host negotiates */
+    int fps;                    /*!< Frame rate the host negotiates */
+    int kbps;                   /*!< USB payload bandwidth in KB/s */
+    int enumeration_ms;         /*!< Delay between uvc_device_init() and the stream start */
+    int restart_ms;             /*!< Stop and restart the stream this long after it started, 0 never */
+    int alt_width;              /*!< Every other restart negotiates this frame size, 0 keeps the size */
+    int alt_height;
+    int alt_fps;
+} sim_uvc_config_t;
+
+/**
+ * @brief What the simulated host received
+ */
+typedef struct {
+    uint32_t frames;            /*!< Frames transferred */
+    uint32_t oversize;          /*!< Frames larger than the transfer buffer, not transferred */
+    uint64_t bytes;             /*!< Payload bytes transferred */
+    int64_t busy_us;            /*!< Time the bus spent transferring */
+    int64_t stream_us;          /*!< Time since the stream started */
+    uint32_t restarts;          /*!< Times the host stopped and restarted the stream */
+    int64_t start_cb_max_us;    /*!< Longest start callback */
+    int64_t stop_cb_max_us;     /*!< Longest stop callback */
+} sim_uvc_stats_t;
+
+/**
+ * @brief Simulated LCD, LVGL holds the display lock render_ms of every period_ms
+ */
+typedef struct {
+    int render_ms;
+    int period_ms;
+} sim_display_config_t;
+
+/**
+ * @brief Who took the display lock
+ */
+typedef struct {
+    uint32_t locks;             /*!< Times the lock was taken */
+    uint32_t callback_locks;    /*!< Times a UVC callback tried to take it, should stay 0 */
+    int64_t max_wait_us;        /*!< Longest wait for the lock */
+} sim_display_stats_t;
+
+/**
+ * @brief Configure the sensor, before app_main runs
+ *
+ * @return ESP_ERR_NOT_FOUND if the directory holds no .jpg file
+ */
+esp_err_t sim_camera_config(const sim_camera_config_t *config);
+
+void sim_camera_stats(sim_camera_stats_t *out);
+
+/**
+ * @brief Configure the host, before app_main runs
+ */
+void sim_uvc_config(const sim_uvc_config_t *config);
+
+/**
+ * @brief Wait until the host started the stream
+ *
+ * @return false if the start callback failed
+ */
+bool sim_uvc_wait_started(void);
+
+/**
+ * @brief Stop the stream and wait until the stop callback returned
+ */
+void sim_uvc_stop(void);
+
+void sim_uvc_stats(sim_uvc_stats_t *out);
+
+/**
+ * @brief Whether the calling thread runs a UVC callback
+ */
+bool sim_uvc_in_callback(void);
+
+/**
+ * @brief Configure the LCD, before app_main runs
+ */
+void sim_display_config(const sim_display_config_t *config);
+
+void sim_display_stats(sim_display_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,263 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Host simulation of the webcam: app_main and the UVC callbacks of main/ run unchanged
+ * against a simulated sensor and a simulated USB host, then the achieved frame rate,
+ * drops and latencies are printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "uvc_frame_config.h"
+#include "stream_stats.h"
+#include "sim.h"
+#if CONFIG_CAMERA_LCD_EYES
+#include "eyes_ctrl.h"
+#endif
+
+static const char *TAG = "host_sim";
+
+void app_main(void);
+
+static const struct {
+    const char *name;
+    uvc_format_t format;
+} s_formats[] = {
+    { "mjpeg", UVC_FORMAT_MJPEG },
+    { "yuy2", UVC_FORMAT_YUY2 },
+    { "nv12", UVC_FORMAT_NV12 },
+    { "gray8", UVC_FORMAT_GRAY8 },
+};
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options]\n"
+           "  -f, --format FMT      mjpeg, yuy2, nv12 or gray8 (default mjpeg)\n"
+           "  -s, --size WxH        frame size the host negotiates (default: first mode of the format)\n"
+           "  -r, --fps N           frame rate the host negotiates (default: the rate of the mode)\n"
+           "  -j, --jpeg-dir DIR    play the .jpg files of DIR in name order (default: synthetic frames)\n"
+           "  -c, --sensor-fps N    frames the sensor delivers per second (default 30)\n"
+           "  -u, --usb MODE        isoc (%d KB/s), bulk (%d KB/s) or a bandwidth in KB/s (default isoc)\n"
+           "  -t, --time S          streaming time in seconds (default 10)\n"
+           "  -R, --restart MS      host restarts the stream every MS milliseconds (default never)\n"
+           "  -a, --alt-size WxH    every other restart negotiates this frame size of the format\n"
+           "  -l, --lcd-render MS   LVGL holds the display lock MS of every MS + 10 milliseconds (default 30)\n"
+           "  -v, --verbose         print debug logs\n",
+           prog, SIM_USB_ISOC_KBPS, SIM_USB_BULK_KBPS);
+}
+
+// Resolve a mode like a host that picks from the descriptors, the first one of the format if width is 0
+static int sim_mode_find(uvc_format_t format, int width, int height)
+{
+    for (int i = 0; i < UVC_MODE_COUNT; i++) {
+        if (UVC_MODES[i].format == format && (width == 0
+                || (UVC_MODES[i].frame.width == width && UVC_MODES[i].frame.height == height))) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void app_main_task(void *arg)
+{
+    (void)arg;
+    app_main();
+}
+
+static void print_latency(const stream_stats_t *cur, const stream_stats_t *prev, stream_stats_lat_t lat, const char *name)
+{
+    printf("  %-8s latency p50 < %"PRIu32" us, p99 < %"PRIu32" us\n", name,
+           stream_stats_percentile(cur, prev, lat, 50), stream_stats_percentile(cur, prev, lat, 99));
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] = {
+        { "format", required_argument, NULL, 'f' },
+        { "size", required_argument, NULL, 's' },
+        { "fps", required_argument, NULL, 'r' },
+        { "jpeg-dir", required_argument, NULL, 'j' },
+        { "sensor-fps", required_argument, NULL, 'c' },
+        { "usb", required_argument, NULL, 'u' },
+        { "time", required_argument, NULL, 't' },
+        { "restart", required_argument, NULL, 'R' },
+        { "alt-size", required_argument, NULL, 'a' },
+        { "lcd-render", required_argument, NULL, 'l' },
+        { "verbose", no_argument, NULL, 'v' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+    sim_camera_config_t camera = { .fps = 30 };
+    sim_uvc_config_t host = { .format = UVC_FORMAT_MJPEG, .kbps = SIM_USB_ISOC_KBPS, .enumeration_ms = 500 };
+    sim_display_config_t display = { .render_ms = 30, .period_ms = 40 };
+    int duration_s = 10;
+    int opt;
+
+    esp_timer_get_time();
+    while ((opt = getopt_long(argc, argv, "f:s:r:j:c:u:t:R:a:l:vh", options, NULL)) != -1) {
+        switch (opt) {
+        case 'f': {
+            int i = 0;
+            for (; i < sizeof(s_formats) / sizeof(s_formats[0]) && strcasecmp(optarg, s_formats[i].name); i++) {
+            }
+            if (i == sizeof(s_formats) / sizeof(s_formats[0])) {
+                fprintf(stderr, "Unknown format %s\n", optarg);
+                return 2;
+            }
+            host.format = s_formats[i].format;
+            break;
+        }
+        case 's':
+            if (sscanf(optarg, "%dx%d", &host.width, &host.height) != 2) {
+                fprintf(stderr, "Size must be WxH\n");
+                return 2;
+            }
+            break;
+        case 'r':
+            host.fps = atoi(optarg);
+            break;
+        case 'j':
+            camera.frames_dir = optarg;
+            break;
+        case 'c':
+            camera.fps = atoi(optarg);
+            break;
+        case 'u':
+            if (strcasecmp(optarg, "isoc") == 0) {
+                host.kbps = SIM_USB_ISOC_KBPS;
+            } else if (strcasecmp(optarg, "bulk") == 0) {
+                host.kbps = SIM_USB_BULK_KBPS;
+            } else {
+                host.kbps = atoi(optarg);
+            }
+            break;
+        case 't':
+            duration_s = atoi(optarg);
+            break;
+        case 'R':
+            host.restart_ms = atoi(optarg);
+            break;
+        case 'a':
+            if (sscanf(optarg, "%dx%d", &host.alt_width, &host.alt_height) != 2) {
+                fprintf(stderr, "Size must be WxH\n");
+                return 2;
+            }
+            break;
+        case 'l':
+            display.render_ms = atoi(optarg);
+            display.period_ms = display.render_ms + 10;
+            break;
+        case 'v':
+            esp_log_verbose = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (host.kbps <= 0 || camera.fps <= 0 || duration_s <= 0 || host.restart_ms < 0 || display.render_ms < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int mode_id = sim_mode_find(host.format, host.width, host.height);
+    if (mode_id < 0) {
+        fprintf(stderr, "No enabled mode for %s %dx%d\n", s_formats[host.format - 1].name, host.width, host.height);
+        return 2;
+    }
+    host.width = UVC_MODES[mode_id].frame.width;
+    host.height = UVC_MODES[mode_id].frame.height;
+    if (host.fps <= 0) {
+        host.fps = UVC_MODES[mode_id].frame.rate;
+    }
+    if (host.alt_width) {
+        int alt_id = sim_mode_find(host.format, host.alt_width, host.alt_height);
+        if (alt_id < 0 || !host.restart_ms) {
+            fprintf(stderr, "--alt-size needs --restart and an enabled mode of the format\n");
+            return 2;
+        }
+        host.alt_fps = UVC_MODES[alt_id].frame.rate;
+    }
+
+    if (sim_camera_config(&camera) != ESP_OK) {
+        return 1;
+    }
+    sim_uvc_config(&host);
+    sim_display_config(&display);
+    if (xTaskCreate(app_main_task, "main", 8192, NULL, 1, NULL) != pdPASS) {
+        return 1;
+    }
+    if (!sim_uvc_wait_started()) {
+        ESP_LOGE(TAG, "Stream start failed");
+        return 1;
+    }
+    sleep(duration_s);
+
+    stream_stats_t cur, zero = { 0 };
+    sim_camera_stats_t sensor;
+    sim_uvc_stats_t usb;
+    stream_stats_snapshot(&cur);
+    sim_camera_stats(&sensor);
+    sim_uvc_stats(&usb);
+    sim_uvc_stop();
+    sim_uvc_stats_t callbacks;
+    sim_display_stats_t lcd;
+    sim_uvc_stats(&callbacks);
+    sim_display_stats(&lcd);
+
+    int64_t elapsed_us = usb.stream_us > 0 ? usb.stream_us : 1;
+    uint32_t dropped = 0;
+    for (int i = 0; i < STREAM_STATS_DROP_MAX; i++) {
+        dropped += cur.dropped[i];
+    }
+    printf("\n===== %s %dx%d @%d fps, sensor %d fps, USB %d KB/s, %.1f s =====\n", s_formats[host.format - 1].name,
+           host.width, host.height, host.fps, camera.fps, host.kbps, elapsed_us / 1e6);
+    printf("  sensor   %"PRIu32" frames, %"PRIu32" lost without a free buffer, %"PRIu32" overwritten, %"PRIu32" of a wrong size\n",
+           sensor.frames, sensor.overruns, sensor.replaced, sensor.mismatched);
+    printf("  pipeline %"PRIu32" captured, %"PRIu32" sent, %"PRIu32" oversize, %"PRIu32" superseded, %"PRIu32" empty fb_get\n",
+           cur.captured, cur.sent, cur.dropped[STREAM_STATS_DROP_OVERSIZE], cur.dropped[STREAM_STATS_DROP_SUPERSEDED], cur.empty);
+    printf("  usb      %"PRIu32" frames, %.1f fps, %.0f KB/s, bus busy %.0f%%\n", usb.frames, usb.frames * 1e6 / elapsed_us,
+           usb.bytes * 1e6 / 1024 / elapsed_us, usb.busy_us * 100.0 / elapsed_us);
+    print_latency(&cur, &zero, STREAM_STATS_LAT_CAPTURE, "capture");
+    print_latency(&cur, &zero, STREAM_STATS_LAT_WAIT, "wait");
+    print_latency(&cur, &zero, STREAM_STATS_LAT_HOLD, "hold");
+    printf("  uvc      %"PRIu32" restarts, longest start_cb %"PRId64" us, stop_cb %"PRId64" us\n", callbacks.restarts,
+           callbacks.start_cb_max_us, callbacks.stop_cb_max_us);
+    printf("  lcd      display lock taken %"PRIu32" times, %"PRIu32" from UVC callbacks, longest wait %"PRId64" us\n",
+           lcd.locks, lcd.callback_locks, lcd.max_wait_us);
+#if CONFIG_CAMERA_LCD_EYES
+    eyes_ctrl_stats_t eyes;
+    eyes_ctrl_get_stats(&eyes);
+    printf("  eyes     %"PRIu32" events posted, %"PRIu32" applied, %"PRIu32" coalesced, %"PRIu32" animations\n",
+           eyes.posted, eyes.applied, eyes.coalesced, eyes.switches);
+#endif
+    // One line for scripts comparing runs
+    printf("RESULT fps=%.2f drops=%"PRIu32" sensor_lost=%"PRIu32" capture_p50_us=%"PRIu32" capture_p99_us=%"PRIu32
+           " callback_display_locks=%"PRIu32" size_mismatch=%"PRIu32"\n",
+           usb.frames * 1e6 / elapsed_us, dropped + usb.oversize, sensor.overruns + sensor.replaced,
+           stream_stats_percentile(&cur, &zero, STREAM_STATS_LAT_CAPTURE, 50),
+           stream_stats_percentile(&cur, &zero, STREAM_STATS_LAT_CAPTURE, 99), lcd.callback_locks, sensor.mismatched);
+    fflush(stdout);
+    // A callback waiting for LVGL stalls the USB stack, fail the run
+    if (lcd.callback_locks) {
+        ESP_LOGE(TAG, "UVC callbacks took the display lock");
+    }
+    // The driver was left at a size the sensor no longer outputs, the stream starves
+    if (sensor.mismatched) {
+        ESP_LOGE(TAG, "Raw frames dropped by the driver for their size");
+    }
+    // The webcam tasks never return, leave them running
+    _exit(lcd.callback_locks || sensor.mismatched ? 1 : 0);
+}
@@ -0,0 +1,162 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Throughput of the software JPEG stage of sw_jpeg.c, in MB of raw frames per second
+ * and per core.
+ *
+ * The encoder is called directly first, then through sw_jpeg_start and sw_jpeg_fb_get
+ * with its task fed by a camera that always has a frame ready, so the difference is
+ * the cost of the stage itself. fmt2jpg_cb is the esp32-camera encoder built for the
+ * host when its sources are found (see CMakeLists.txt), else the libjpeg stand-in of
+ * mock/, which only tracks the cost of the stage. The ESP32-S3 is slower than the host
+ * either way.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "img_converters.h"
+#include "sw_jpeg.h"
+
+#define BENCH_MIN_NS        500000000LL
+// Output buffer and quality of the VGA MJPEG mode of uvc_modes.def
+#define BENCH_OUT_SIZE      (75 * 1024)
+#define BENCH_QUALITY       12
+
+static struct {
+    camera_fb_t fb;
+    uint32_t gets;
+} s_cam;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// The camera of the stage, it always has the same frame ready
+camera_fb_t *esp_camera_fb_get(void)
+{
+    s_cam.gets++;
+    return &s_cam.fb;
+}
+
+void esp_camera_fb_return(camera_fb_t *fb)
+{
+    (void)fb;
+}
+
+static uint8_t clamp_u8(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+// Gradients, a bright disc and sensor noise, roughly the entropy of an indoor scene
+static void synthetic_frame(uint8_t *buf, int width, int height, pixformat_t format)
+{
+    uint32_t seed = 12345;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            seed = seed * 1103515245 + 12345;
+            int noise = (int)((seed >> 16) & 7) - 4;
+            int r = x * 255 / width;
+            int g = y * 255 / height;
+            int b = 128 + ((x / 40 + y / 40) & 1) * 64;
+            if ((x - width / 3) * (x - width / 3) + (y - height / 2) * (y - height / 2) < height * height / 16) {
+                r = 230;
+                g = 200;
+                b = 40;
+            }
+            r = clamp_u8(r + noise);
+            g = clamp_u8(g + noise);
+            b = clamp_u8(b + noise);
+            uint8_t *p = &buf[((size_t)y * width + x) * 2];
+            if (format == PIXFORMAT_YUV422) {
+                p[0] = clamp_u8((77 * r + 150 * g + 29 * b) >> 8);
+                // U on even pixels, V on odd ones
+                p[1] = (x & 1) ? clamp_u8(((128 * r - 107 * g - 21 * b) >> 8) + 128)
+                       : clamp_u8(((-43 * r - 85 * g + 128 * b) >> 8) + 128);
+            } else {
+                uint16_t px = (uint16_t)(((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3));
+                p[0] = px >> 8;
+                p[1] = px & 0xff;
+            }
+        }
+    }
+}
+
+static size_t count_cb(void *arg, size_t index, const void *data, size_t len)
+{
+    (void)data;
+    *(size_t *)arg = index + len;
+    return len;
+}
+
+static void bench(const char *name, int width, int height, pixformat_t format)
+{
+    size_t raw_len = (size_t)width * height * 2;
+    s_cam.fb = (camera_fb_t) {
+        .buf = malloc(raw_len),
+        .len = raw_len,
+        .width = width,
+        .height = height,
+        .format = format,
+    };
+    synthetic_frame(s_cam.fb.buf, width, height, format);
+    // The encoder quality sw_jpeg maps BENCH_QUALITY to
+    uint8_t quality = 100 - BENCH_QUALITY * 100 / 63;
+
+    int frames = 0;
+    size_t jpeg_len = 0;
+    int64_t start = now_ns();
+    int64_t elapsed;
+    do {
+        fmt2jpg_cb(s_cam.fb.buf, raw_len, width, height, format, quality, count_cb, &jpeg_len);
+        frames++;
+        elapsed = now_ns() - start;
+    } while (elapsed < BENCH_MIN_NS);
+    double direct_mbps = (double)raw_len * frames / elapsed * 1000.0;
+    double direct_fps = frames * 1e9 / elapsed;
+
+    if (sw_jpeg_start(BENCH_OUT_SIZE, BENCH_QUALITY) != ESP_OK) {
+        fprintf(stderr, "sw_jpeg_start failed\n");
+        exit(1);
+    }
+    int truncated = 0;
+    frames = 0;
+    start = now_ns();
+    do {
+        camera_fb_t *fb = sw_jpeg_fb_get();
+        if (!fb) {
+            fprintf(stderr, "No frame from the encoder\n");
+            exit(1);
+        }
+        truncated += fb->len > BENCH_OUT_SIZE;
+        sw_jpeg_fb_return(fb);
+        frames++;
+        elapsed = now_ns() - start;
+    } while (elapsed < BENCH_MIN_NS);
+    sw_jpeg_stop();
+    double stage_mbps = (double)raw_len * frames / elapsed * 1000.0;
+
+    printf("%-14s encoder %6.1f MB/s %6.1f fps   stage %6.1f MB/s %6.1f fps   JPEG %5zu KB%s\n",
+           name, direct_mbps, direct_fps, stage_mbps, frames * 1e9 / elapsed, jpeg_len / 1024,
+           truncated ? "  (over the output buffer)" : "");
+    free(s_cam.fb.buf);
+}
+
+int main(void)
+{
+    printf("Software JPEG on one core, quality %d, encoder: %s\n", BENCH_QUALITY, SW_JPEG_BENCH_ENCODER);
+    bench("VGA YUV422", 640, 480, PIXFORMAT_YUV422);
+    bench("VGA RGB565", 640, 480, PIXFORMAT_RGB565);
+    bench("QVGA YUV422", 320, 240, PIXFORMAT_YUV422);
+    bench("HD YUV422", 1280, 720, PIXFORMAT_YUV422);
+    return 0;
+}
@@ -0,0 +1,390 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Test of the UVC units uvc_ctrl.c adds to the descriptor of usb_device_uvc.
+ *
+ * The descriptor below is laid out like the one of the component for one MJPEG camera.
+ * The patched copy must still chain up to its total length, with the Processing Unit and
+ * the Extension Unit between the Camera Terminal and the Output Terminal. Control
+ * requests are then sent the way TinyUSB passes them on: the image controls of the
+ * Camera Terminal and the Processing Unit go through sensor_ctrl.c, the Extension Unit
+ * is answered from the published telemetry, all others reach the video class driver.
+ * The block returned by GET_CUR is written to the file given as argument, CTest decodes
+ * it with tools/uvc_telemetry.py. Malformed descriptors are patched in child processes,
+ * placed against an inaccessible page so that a read past their total length faults.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "uvc_telemetry.h"
+#include "sensor_ctrl.h"
+#include "uvc_ctrl.h"
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define VC_ITF          0
+#define VS_ITF          1
+#define CT_ID           1
+#define OT_ID           2
+
+#define UVC_SET_CUR     0x01
+#define UVC_GET_CUR     0x81
+#define UVC_GET_MIN     0x82
+#define UVC_GET_MAX     0x83
+#define UVC_GET_RES     0x84
+#define UVC_GET_LEN     0x85
+#define UVC_GET_INFO    0x86
+#define UVC_GET_DEF     0x87
+
+#define PU_DESC_LEN     13
+#define XU_DESC_LEN     26
+#define ADDED_LEN       (PU_DESC_LEN + XU_DESC_LEN)
+
+static const uint8_t s_desc[] = {
+    // Configuration, 2 interfaces
+    0x09, 0x02, 105, 0x00, 0x02, 0x01, 0x00, 0x80, 0xfa,
+    // Interface association
+    0x08, 0x0b, VC_ITF, 0x02, 0x0e, 0x03, 0x00, 0x00,
+    // Video Control interface
+    0x09, 0x04, VC_ITF, 0x00, 0x00, 0x0e, 0x01, 0x00, 0x00,
+    // VC header, UVC 1.5, 40 bytes of class-specific descriptors, 48 MHz clock
+    0x0d, 0x24, 0x01, 0x50, 0x01, 40, 0x00, 0x00, 0x6c, 0xdc, 0x02, 0x01, VS_ITF,
+    // Camera Terminal without controls
+    0x12, 0x24, 0x02, CT_ID, 0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+    // Output Terminal fed by the camera
+    0x09, 0x24, 0x03, OT_ID, 0x01, 0x01, 0x00, CT_ID, 0x00,
+    // Video Streaming interface, alternate 0
+    0x09, 0x04, VS_ITF, 0x00, 0x00, 0x0e, 0x02, 0x00, 0x00,
+    // VS input header linked to the Output Terminal
+    0x0e, 0x24, 0x01, 0x01, 0x4b, 0x00, 0x81, 0x00, OT_ID, 0x00, 0x00, 0x00, 0x01, 0x00,
+    // Alternate 1 with the isochronous endpoint
+    0x09, 0x04, VS_ITF, 0x01, 0x01, 0x0e, 0x02, 0x00, 0x00,
+    0x07, 0x05, 0x81, 0x05, 0x00, 0x02, 0x01,
+};
+
+static struct {
+    int real_calls;
+    uint8_t data[64];
+    uint16_t len;
+} s_ctrl;
+
+// Descriptor of the component, replaced by the malformed ones
+static const uint8_t *s_real_desc = s_desc;
+
+uint8_t const *__real_tud_descriptor_configuration_cb(uint8_t index)
+{
+    return index == 0 ? s_real_desc : NULL;
+}
+
+bool __real_videod_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request)
+{
+    (void)rhport;
+    (void)stage;
+    (void)request;
+    s_ctrl.real_calls++;
+    return true;
+}
+
+// The host side of the data stage: IN data is captured, OUT data comes from s_ctrl.data
+bool tud_control_xfer(uint8_t rhport, tusb_control_request_t const *request, void *buffer, uint16_t len)
+{
+    (void)rhport;
+    CHECK(len <= request->wLength && len <= sizeof(s_ctrl.data));
+    if (request->bmRequestType_bit.direction) {
+        memcpy(s_ctrl.data, buffer, len);
+    } else {
+        memcpy(buffer, s_ctrl.data, len);
+    }
+    s_ctrl.len = len;
+    return true;
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return get_u16(p) | (uint32_t)get_u16(p + 2) << 16;
+}
+
+// Class request to an entity of an interface, run through all its stages
+static bool request(uint8_t itf, uint8_t entity, uint8_t selector, uint8_t req, uint16_t len)
+{
+    tusb_control_request_t r = {
+        .bmRequestType_bit = {
+            .recipient = TUSB_REQ_RCPT_INTERFACE,
+            .type = TUSB_REQ_TYPE_CLASS,
+            .direction = req >> 7,
+        },
+        .bRequest = req,
+        .wValue = selector << 8,
+        .wIndex = entity << 8 | itf,
+        .wLength = len,
+    };
+    s_ctrl.len = 0;
+    if (!__wrap_videod_control_xfer_cb(0, CONTROL_STAGE_SETUP, &r)) {
+        return false;
+    }
+    return __wrap_videod_control_xfer_cb(0, CONTROL_STAGE_DATA, &r)
+           && __wrap_videod_control_xfer_cb(0, CONTROL_STAGE_ACK, &r);
+}
+
+static const uint8_t *find_entity(const uint8_t *vc_header, uint8_t subtype, uint8_t id)
+{
+    const uint8_t *end = vc_header + get_u16(vc_header + 5);
+    for (const uint8_t *d = vc_header; d < end; d += d[0]) {
+        if (d[1] == 0x24 && d[2] == subtype && d[3] == id) {
+            return d;
+        }
+    }
+    return NULL;
+}
+
+static void test_descriptor(void)
+{
+    const uint8_t *desc = __wrap_tud_descriptor_configuration_cb(0);
+    CHECK(desc != s_desc);
+    CHECK(__wrap_tud_descriptor_configuration_cb(0) == desc);
+    uint16_t total = get_u16(desc + 2);
+    CHECK(total == sizeof(s_desc) + ADDED_LEN);
+
+    // Every descriptor still chains up to the total length
+    size_t pos = 0;
+    while (pos < total) {
+        CHECK(desc[pos] >= 2);
+        pos += desc[pos];
+    }
+    CHECK(pos == total);
+
+    const uint8_t *header = desc + 26;
+    CHECK(header[1] == 0x24 && header[2] == 0x01);
+    CHECK(get_u16(header + 5) == 40 + ADDED_LEN);
+    const uint8_t *ct = find_entity(header, 0x02, CT_ID);
+    const uint8_t *ot = find_entity(header, 0x03, OT_ID);
+    const uint8_t *pu = find_entity(header, 0x05, UVC_CTRL_PU_ID);
+    const uint8_t *xu = find_entity(header, 0x06, UVC_CTRL_XU_ID);
+    CHECK(ct && ot && pu && xu);
+    // Camera -> Processing Unit -> Extension Unit -> Output Terminal
+    CHECK(ot[7] == UVC_CTRL_XU_ID);
+    // AE mode (D1) only, the exposure in lines is on the Extension Unit
+    CHECK(ct[14] == 3 && ct[15] == 0x02 && ct[16] == 0 && ct[17] == 0);
+    // UVC 1.5 layout, brightness D0, contrast D1, saturation D3, sharpness D4, gain D9, WB auto D12
+    CHECK(pu[0] == PU_DESC_LEN && pu[4] == CT_ID && pu[7] == 3);
+    CHECK(pu[8] == 0x1b && pu[9] == 0x12 && pu[10] == 0);
+    static const uint8_t guid[16] = { UVC_TELEMETRY_XU_GUID };
+    CHECK(xu[0] == XU_DESC_LEN && memcmp(xu + 4, guid, 16) == 0);
+    CHECK(xu[20] == 4 && xu[21] == 1 && xu[22] == UVC_CTRL_PU_ID);
+    CHECK(xu[23] == 1 && xu[24] == 0x0f);
+    // The streaming interface follows unchanged
+    CHECK(memcmp(header + get_u16(header + 5), s_desc + 26 + 40, sizeof(s_desc) - 26 - 40) == 0);
+}
+
+static void test_telemetry(const char *dump_path)
+{
+    uvc_telemetry_t t = {
+        .version = UVC_TELEMETRY_VERSION,
+        .size = sizeof(uvc_telemetry_t),
+        .format = 3,
+        .jpeg_quality = 17,
+        .width = 1280,
+        .height = 720,
+        .uptime_ms = 123456,
+        .frames_captured = 4000000001u,
+        .frames_sent = 3999999000u,
+        .frames_dropped = 1001,
+        .fb_get_empty = 77,
+        .fps_x10 = 297,
+        .requested_fps = 30,
+        .heap_internal_free = 123456,
+        .heap_psram_free = 7654321,
+        .capture_p50_us = 4100,
+        .capture_p99_us = 33000,
+    };
+    uvc_telemetry_publish(&t);
+
+    CHECK(request(VC_ITF, UVC_CTRL_XU_ID, UVC_TELEMETRY_XU_SELECTOR, UVC_GET_LEN, 2));
+    CHECK(s_ctrl.len == 2 && get_u16(s_ctrl.data) == sizeof(uvc_telemetry_t));
+    CHECK(request(VC_ITF, UVC_CTRL_XU_ID, UVC_TELEMETRY_XU_SELECTOR, UVC_GET_INFO, 1));
+    CHECK(s_ctrl.len == 1 && s_ctrl.data[0] == 0x01);
+    CHECK(request(VC_ITF, UVC_CTRL_XU_ID, UVC_TELEMETRY_XU_SELECTOR, UVC_GET_CUR, sizeof(uvc_telemetry_t)));
+    CHECK(s_ctrl.len == sizeof(uvc_telemetry_t) && memcmp(s_ctrl.data, &t, sizeof(t)) == 0);
+
+    // Read-only, and nothing behind other selectors
+    CHECK(!request(VC_ITF, UVC_CTRL_XU_ID, UVC_TELEMETRY_XU_SELECTOR, UVC_SET_CUR, sizeof(uvc_telemetry_t)));
+    CHECK(!request(VC_ITF, UVC_CTRL_XU_ID, UVC_TELEMETRY_XU_SELECTOR, UVC_GET_MIN, sizeof(uvc_telemetry_t)));
+    CHECK(!request(VC_ITF, UVC_CTRL_XU_ID, XU_VFLIP_CONTROL + 1, UVC_GET_CUR, sizeof(uvc_telemetry_t)));
+    CHECK(s_ctrl.real_calls == 0);
+
+    if (dump_path) {
+        CHECK(request(VC_ITF, UVC_CTRL_XU_ID, UVC_TELEMETRY_XU_SELECTOR, UVC_GET_CUR, sizeof(uvc_telemetry_t)));
+        FILE *f = fopen(dump_path, "wb");
+        CHECK(f && fwrite(s_ctrl.data, 1, s_ctrl.len, f) == s_ctrl.len);
+        fclose(f);
+    }
+}
+
+// Host side view of a control: value of a GET request, sign extended for 2 byte values
+static int32_t get_value(uint8_t entity, uint8_t selector, uint8_t req, uint16_t len)
+{
+    CHECK(request(VC_ITF, entity, selector, req, len));
+    CHECK(s_ctrl.len == len);
+    return len == 1 ? s_ctrl.data[0] : len == 2 ? (int16_t)get_u16(s_ctrl.data) : (int32_t)get_u32(s_ctrl.data);
+}
+
+static bool set_value(uint8_t entity, uint8_t selector, uint16_t len, uint32_t value)
+{
+    for (int i = 0; i < len; i++) {
+        s_ctrl.data[i] = value >> (8 * i);
+    }
+    return request(VC_ITF, entity, selector, UVC_SET_CUR, len);
+}
+
+static void test_sensor_controls(void)
+{
+    // Brightness is signed on both sides
+    CHECK(get_value(UVC_CTRL_PU_ID, PU_BRIGHTNESS_CONTROL, UVC_GET_LEN, 2) == 2);
+    CHECK(get_value(UVC_CTRL_PU_ID, PU_BRIGHTNESS_CONTROL, UVC_GET_INFO, 1) == 0x03);
+    CHECK(get_value(UVC_CTRL_PU_ID, PU_BRIGHTNESS_CONTROL, UVC_GET_MIN, 2) == -2);
+    CHECK(get_value(UVC_CTRL_PU_ID, PU_BRIGHTNESS_CONTROL, UVC_GET_MAX, 2) == 2);
+    CHECK(get_value(UVC_CTRL_PU_ID, PU_BRIGHTNESS_CONTROL, UVC_GET_RES, 2) == 1);
+    CHECK(get_value(UVC_CTRL_PU_ID, PU_BRIGHTNESS_CONTROL, UVC_GET_DEF, 2) == sensor_ctrl_default(SENSOR_CTRL_BRIGHTNESS));
+    CHECK(set_value(UVC_CTRL_PU_ID, PU_BRIGHTNESS_CONTROL, 2, (uint16_t) -1));
+    CHECK(sensor_ctrl_get(SENSOR_CTRL_BRIGHTNESS) == -1);
+    CHECK(get_value(UVC_CTRL_PU_ID, PU_BRIGHTNESS_CONTROL, UVC_GET_CUR, 2) == -1);
+
+    // Contrast is unsigned for the host, the sensor range -2..2 is shifted to 0..4
+    CHECK(get_value(UVC_CTRL_PU_ID, PU_CONTRAST_CONTROL, UVC_GET_MIN, 2) == 0);
+    CHECK(get_value(UVC_CTRL_PU_ID, PU_CONTRAST_CONTROL, UVC_GET_MAX, 2) == 4);
+    CHECK(set_value(UVC_CTRL_PU_ID, PU_CONTRAST_CONTROL, 2, 3));
+    CHECK(sensor_ctrl_get(SENSOR_CTRL_CONTRAST) == 1);
+    CHECK(get_value(UVC_CTRL_PU_ID, PU_CONTRAST_CONTROL, UVC_GET_CUR, 2) == 3);
+
+    // Out of range values are clamped by sensor_ctrl_set()
+    CHECK(set_value(UVC_CTRL_PU_ID, PU_GAIN_CONTROL, 2, 1000));
+    CHECK(sensor_ctrl_get(SENSOR_CTRL_GAIN) == 30);
+    CHECK(set_value(UVC_CTRL_PU_ID, PU_WHITE_BALANCE_TEMPERATURE_AUTO_CONTROL, 1, 0));
+    CHECK(sensor_ctrl_get(SENSOR_CTRL_AUTO_WB) == 0);
+
+    // AE mode: manual and auto only, no range
+    CHECK(get_value(CT_ID, CT_AE_MODE_CONTROL, UVC_GET_RES, 1) == 0x03);
+    CHECK(!request(VC_ITF, CT_ID, CT_AE_MODE_CONTROL, UVC_GET_MIN, 1));
+    CHECK(set_value(CT_ID, CT_AE_MODE_CONTROL, 1, 0x01));
+    CHECK(sensor_ctrl_get(SENSOR_CTRL_AUTO_EXPOSURE) == 0);
+    CHECK(get_value(CT_ID, CT_AE_MODE_CONTROL, UVC_GET_CUR, 1) == 0x01);
+    CHECK(!set_value(CT_ID, CT_AE_MODE_CONTROL, 1, 0x04));
+    CHECK(set_value(CT_ID, CT_AE_MODE_CONTROL, 1, 0x02));
+    CHECK(sensor_ctrl_get(SENSOR_CTRL_AUTO_EXPOSURE) == 1);
+
+    // Exposure in lines and the flips are on the Extension Unit, the Camera Terminal has no exposure time
+    CHECK(!request(VC_ITF, CT_ID, 0x04, UVC_GET_CUR, 4));
+    CHECK(get_value(UVC_CTRL_XU_ID, XU_EXPOSURE_LINES_CONTROL, UVC_GET_LEN, 2) == 2);
+    CHECK(get_value(UVC_CTRL_XU_ID, XU_EXPOSURE_LINES_CONTROL, UVC_GET_MAX, 2) == 1200);
+    CHECK(set_value(UVC_CTRL_XU_ID, XU_EXPOSURE_LINES_CONTROL, 2, 600));
+    CHECK(sensor_ctrl_get(SENSOR_CTRL_EXPOSURE) == 600);
+    CHECK(get_value(UVC_CTRL_XU_ID, XU_EXPOSURE_LINES_CONTROL, UVC_GET_CUR, 2) == 600);
+    CHECK(get_value(UVC_CTRL_XU_ID, XU_HFLIP_CONTROL, UVC_GET_MAX, 1) == 1);
+    CHECK(set_value(UVC_CTRL_XU_ID, XU_HFLIP_CONTROL, 1, 1));
+    CHECK(sensor_ctrl_get(SENSOR_CTRL_HFLIP) == 1);
+    CHECK(set_value(UVC_CTRL_XU_ID, XU_VFLIP_CONTROL, 1, 1));
+    CHECK(get_value(UVC_CTRL_XU_ID, XU_VFLIP_CONTROL, UVC_GET_CUR, 1) == 1);
+    CHECK(set_value(UVC_CTRL_XU_ID, XU_VFLIP_CONTROL, 1, 2) && sensor_ctrl_get(SENSOR_CTRL_VFLIP) == 1);
+
+    // Wrong length, controls without a UVC mapping and unknown requests stall
+    CHECK(!set_value(UVC_CTRL_PU_ID, PU_BRIGHTNESS_CONTROL, 4, 1));
+    CHECK(!request(VC_ITF, UVC_CTRL_PU_ID, 0x06, UVC_GET_CUR, 2));
+    CHECK(!request(VC_ITF, CT_ID, 0x0b, UVC_GET_CUR, 2));
+    CHECK(!request(VC_ITF, UVC_CTRL_PU_ID, PU_BRIGHTNESS_CONTROL, 0x88, 2));
+    CHECK(s_ctrl.real_calls == 0);
+}
+
+static void test_forward(void)
+{
+    // Interface controls, unknown entities and the streaming interface stay with TinyUSB
+    int calls = s_ctrl.real_calls;
+    CHECK(request(VC_ITF, 0, 0x02, UVC_GET_CUR, 1));
+    CHECK(request(VC_ITF, OT_ID, 0x01, UVC_GET_CUR, 1));
+    CHECK(request(VS_ITF, UVC_CTRL_XU_ID, UVC_TELEMETRY_XU_SELECTOR, UVC_GET_CUR, 26));
+    CHECK(s_ctrl.real_calls == calls + 3 * 3);
+}
+
+// Patch a descriptor in a child, since the first patch is kept, and expect it unchanged
+static void malformed_check(const char *name, const uint8_t *bytes, size_t len)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    uint8_t *map = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    CHECK(map != MAP_FAILED && mprotect(map + page, page, PROT_NONE) == 0);
+    uint8_t *desc = map + page - len;
+    memcpy(desc, bytes, len);
+    fflush(stdout);
+    pid_t pid = fork();
+    CHECK(pid >= 0);
+    if (pid == 0) {
+        s_real_desc = desc;
+        _exit(__wrap_tud_descriptor_configuration_cb(0) == desc ? 0 : 1);
+    }
+    int status;
+    CHECK(waitpid(pid, &status, 0) == pid);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Malformed descriptor '%s': %s\n", name, WIFSIGNALED(status) ? "read past its end" : "patched");
+        exit(1);
+    }
+    munmap(map, 2 * page);
+}
+
+static void test_malformed(void)
+{
+    // Configuration descriptor cut short, and one without any other descriptor
+    static const uint8_t cut[] = { 0x09, 0x02, 0x04, 0x00 };
+    static const uint8_t config_only[] = { 0x09, 0x02, 0x09, 0x00, 0x01, 0x01, 0x00, 0x80, 0xfa };
+    // Zero length descriptors, first and after the configuration
+    static const uint8_t zero_first[] = { 0x00, 0x02, 0x02, 0x00 };
+    static const uint8_t zero_next[] = { 0x09, 0x02, 0x0b, 0x00, 0x01, 0x01, 0x00, 0x80, 0xfa, 0x00, 0x04 };
+    // Video Control interface whose length runs past the total
+    static const uint8_t itf_past[] = { 0x09, 0x02, 0x10, 0x00, 0x01, 0x01, 0x00, 0x80, 0xfa,
+                                        0x09, 0x04, VC_ITF, 0x00, 0x00, 0x0e, 0x01 };
+    // VC header whose class-specific length runs past the total
+    uint8_t header_past[9 + 9 + 13 + 18];
+    memcpy(header_past, s_desc, 9);
+    memcpy(header_past + 9, s_desc + 17, sizeof(header_past) - 9);
+    header_past[2] = sizeof(header_past);
+    // Camera Terminal cut by the end of the class-specific descriptors
+    uint8_t unit_past[sizeof(header_past)];
+    memcpy(unit_past, header_past, sizeof(unit_past));
+    unit_past[9 + 9 + 5] = 13 + 10;
+    unit_past[9 + 9 + 13] = 0x40;
+
+    malformed_check("cut", cut, sizeof(cut));
+    malformed_check("config only", config_only, sizeof(config_only));
+    malformed_check("zero length first", zero_first, sizeof(zero_first));
+    malformed_check("zero length next", zero_next, sizeof(zero_next));
+    malformed_check("interface past the end", itf_past, sizeof(itf_past));
+    malformed_check("header past the end", header_past, sizeof(header_past));
+    malformed_check("unit past the end", unit_past, sizeof(unit_past));
+}
+
+int main(int argc, char **argv)
+{
+    test_malformed();
+    test_descriptor();
+    test_telemetry(argc > 1 ? argv[1] : NULL);
+    test_sensor_controls();
+    test_forward();
+    printf("uvc_ctrl: Processing Unit %d and Extension Unit %d in the descriptor, controls set through sensor_ctrl, "
+           "telemetry read back%s%s\n", UVC_CTRL_PU_ID, UVC_CTRL_XU_ID, argc > 1 ? " to " : "", argc > 1 ? argv[1] : "");
+    return 0;
+}
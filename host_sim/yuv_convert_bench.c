@@ -0,0 +1,207 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Correctness and speed of the YUV422 kernels of yuv_convert.c.
+ *
+ * The kernels are compared byte for byte with a plain per pixel reference, on aligned
+ * and misaligned buffers, in place and on sizes that leave a tail after the word loop.
+ * The benchmark then reports MB/s of YUYV input against the reference loops, for NV12
+ * a naive conversion that writes the luma plane in one pass over the frame and the
+ * chroma plane in a second one. With
+ * --check only the comparison runs, that is what CTest does.
+ *
+ * The target is built without auto-vectorization, which the Xtensa compiler of the
+ * ESP32-S3 does not do either, so the reference stays a per pixel loop like on target.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "yuv_convert.h"
+
+#define BENCH_MIN_NS    300000000LL
+#define BENCH_WIDTH     640
+#define BENCH_HEIGHT    480
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void fill_random(uint8_t *buf, size_t len, uint32_t seed)
+{
+    for (size_t i = 0; i < len; i++) {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = (uint8_t)(seed >> 16);
+    }
+}
+
+static void ref_gray8(const uint8_t *src, uint8_t *dst, size_t pixels)
+{
+    for (size_t i = 0; i < pixels; i++) {
+        dst[i] = src[2 * i];
+    }
+}
+
+// Two passes over the frame: luma plane first, then the chroma of each pair of rows
+static void ref_nv12(const uint8_t *src, uint8_t *dst, size_t width, size_t height)
+{
+    size_t stride = width * 2;
+    for (size_t i = 0; i < width * height; i++) {
+        dst[i] = src[2 * i];
+    }
+    uint8_t *uv = dst + width * height;
+    for (size_t y = 0; y < height; y += 2) {
+        const uint8_t *s0 = src + y * stride;
+        const uint8_t *s1 = s0 + stride;
+        for (size_t x = 1; x < stride; x += 2) {
+            *uv++ = (s0[x] + s1[x] + 1) >> 1;
+        }
+    }
+}
+
+static int check_gray8(void)
+{
+    static const size_t sizes[] = { 0, 2, 4, 6, 8, 14, 640 * 3 + 2, 320 * 240 };
+    int failed = 0;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t pixels = sizes[s];
+        // Offsets move src and dst off the word alignment of the fast path
+        for (int offset = 0; offset < 4; offset++) {
+            uint8_t *src = malloc(pixels * 2 + 4);
+            uint8_t *dst = malloc(pixels + 4);
+            uint8_t *ref = malloc(pixels + 4);
+            fill_random(src, pixels * 2 + 4, (uint32_t)(pixels + offset));
+            ref_gray8(src + offset, ref, pixels);
+            yuv422_to_gray8(src + offset, dst + (offset & 1), pixels);
+            if (memcmp(dst + (offset & 1), ref, pixels)) {
+                printf("FAIL gray8 %zu pixels, offset %d\n", pixels, offset);
+                failed = 1;
+            }
+            // In place, like usb_webcam_main.c converts the camera buffer
+            yuv422_to_gray8(src + offset, src + offset, pixels);
+            if (memcmp(src + offset, ref, pixels)) {
+                printf("FAIL gray8 in place %zu pixels, offset %d\n", pixels, offset);
+                failed = 1;
+            }
+            free(src);
+            free(dst);
+            free(ref);
+        }
+    }
+    return failed;
+}
+
+static int check_nv12(void)
+{
+    static const struct {
+        size_t width;
+        size_t height;
+    } sizes[] = { { 2, 2 }, { 4, 2 }, { 6, 4 }, { 14, 6 }, { 162, 10 }, { 320, 240 } };
+    int failed = 0;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t w = sizes[s].width;
+        size_t h = sizes[s].height;
+        size_t out_len = w * h * 3 / 2;
+        for (int offset = 0; offset < 4; offset += 2) {
+            uint8_t *src = malloc(w * h * 2 + 4);
+            uint8_t *dst = malloc(out_len + 4);
+            uint8_t *ref = malloc(out_len);
+            fill_random(src, w * h * 2 + 4, (uint32_t)(w * h + offset));
+            ref_nv12(src + offset, ref, w, h);
+            yuv422_to_nv12(src + offset, dst + offset, w, h);
+            if (memcmp(dst + offset, ref, out_len)) {
+                printf("FAIL nv12 %zux%zu, offset %d\n", w, h, offset);
+                failed = 1;
+            }
+            free(src);
+            free(dst);
+            free(ref);
+        }
+    }
+    return failed;
+}
+
+static void bench_gray8(void)
+{
+    size_t pixels = (size_t)BENCH_WIDTH * BENCH_HEIGHT;
+    uint8_t *src = malloc(pixels * 2);
+    uint8_t *dst = malloc(pixels);
+    fill_random(src, pixels * 2, 1);
+
+    double mbps[2];
+    for (int k = 0; k < 2; k++) {
+        int runs = 0;
+        int64_t start = now_ns();
+        int64_t elapsed;
+        do {
+            if (k == 0) {
+                ref_gray8(src, dst, pixels);
+            } else {
+                yuv422_to_gray8(src, dst, pixels);
+            }
+            runs++;
+            elapsed = now_ns() - start;
+        } while (elapsed < BENCH_MIN_NS);
+        mbps[k] = (double)pixels * 2 * runs / elapsed * 1000.0;
+    }
+    // Keeps the output alive
+    volatile uint8_t sink = dst[pixels / 2];
+    (void)sink;
+    printf("gray8 %dx%d   per pixel %7.1f MB/s   yuv422_to_gray8 %7.1f MB/s   x%.1f\n",
+           BENCH_WIDTH, BENCH_HEIGHT, mbps[0], mbps[1], mbps[1] / mbps[0]);
+    free(src);
+    free(dst);
+}
+
+static void bench_nv12(void)
+{
+    size_t pixels = (size_t)BENCH_WIDTH * BENCH_HEIGHT;
+    uint8_t *src = malloc(pixels * 2);
+    uint8_t *dst = malloc(pixels * 3 / 2);
+    fill_random(src, pixels * 2, 2);
+
+    double mbps[2];
+    for (int k = 0; k < 2; k++) {
+        int runs = 0;
+        int64_t start = now_ns();
+        int64_t elapsed;
+        do {
+            if (k == 0) {
+                ref_nv12(src, dst, BENCH_WIDTH, BENCH_HEIGHT);
+            } else {
+                yuv422_to_nv12(src, dst, BENCH_WIDTH, BENCH_HEIGHT);
+            }
+            runs++;
+            elapsed = now_ns() - start;
+        } while (elapsed < BENCH_MIN_NS);
+        mbps[k] = (double)pixels * 2 * runs / elapsed * 1000.0;
+    }
+    volatile uint8_t sink = dst[pixels + 1];
+    (void)sink;
+    printf("nv12  %dx%d   two-pass  %7.1f MB/s   yuv422_to_nv12  %7.1f MB/s   x%.1f\n",
+           BENCH_WIDTH, BENCH_HEIGHT, mbps[0], mbps[1], mbps[1] / mbps[0]);
+    free(src);
+    free(dst);
+}
+
+int main(int argc, char **argv)
+{
+    bool check_only = argc > 1 && strcmp(argv[1], "--check") == 0;
+    int failed = check_gray8() | check_nv12();
+    printf("yuv_convert: kernels %s the reference\n", failed ? "DIFFER from" : "match");
+    if (failed || check_only) {
+        return failed;
+    }
+    bench_gray8();
+    bench_nv12();
+    return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "esp_log.h"
+#include "sensor_ctrl.h"
+#include "camera_store.h"
+
+static const char *TAG = "camera_store";
+
+#define STORE_NAMESPACE     "webcam"
+#define STORE_KEY_MODE      "mode"
+#define STORE_KEY_TUNING    "tuning"
+// Bump when the layout of camera_store_tuning_t or the meaning of a control changes
+#define STORE_TUNING_VERSION    1
+
+typedef struct {
+    uint16_t version;
+    uint16_t pid;                       // Sensor the values were taken from
+    int16_t ctrl[SENSOR_CTRL_MAX];
+    sensor_ctrl_exposure_t exposure;
+    uint8_t exposure_valid;
+} camera_store_tuning_t;
+
+static nvs_handle_t s_nvs;
+static bool s_nvs_open;
+static uint32_t s_saved_mode;
+static camera_store_tuning_t s_saved_tuning;
+
+esp_err_t camera_store_init(void)
+{
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_LOGW(TAG, "NVS partition is full or outdated, erasing it");
+        ret = nvs_flash_erase();
+        if (ret == ESP_OK) {
+            ret = nvs_flash_init();
+        }
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = nvs_open(STORE_NAMESPACE, NVS_READWRITE, &s_nvs);
+    s_nvs_open = ret == ESP_OK;
+    return ret;
+}
+
+esp_err_t camera_store_load_mode(uint32_t *mode_key)
+{
+    if (!s_nvs_open) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t ret = nvs_get_u32(s_nvs, STORE_KEY_MODE, mode_key);
+    if (ret == ESP_OK) {
+        s_saved_mode = *mode_key;
+    }
+    return ret;
+}
+
+void camera_store_save_mode(uint32_t mode_key)
+{
+    if (!s_nvs_open || mode_key == s_saved_mode) {
+        return;
+    }
+    if (nvs_set_u32(s_nvs, STORE_KEY_MODE, mode_key) == ESP_OK && nvs_commit(s_nvs) == ESP_OK) {
+        s_saved_mode = mode_key;
+    } else {
+        ESP_LOGW(TAG, "Failed to store the mode");
+    }
+}
+
+void camera_store_restore(sensor_t *s)
+{
+    if (!s_nvs_open) {
+        return;
+    }
+    camera_store_tuning_t tuning;
+    size_t len = sizeof(tuning);
+    if (nvs_get_blob(s_nvs, STORE_KEY_TUNING, &tuning, &len) != ESP_OK || len != sizeof(tuning)
+            || tuning.version != STORE_TUNING_VERSION) {
+        return;
+    }
+    s_saved_tuning = tuning;
+    if (tuning.pid != s->id.PID) {
+        ESP_LOGI(TAG, "Stored tuning is for sensor 0x%x, ignored", tuning.pid);
+        return;
+    }
+
+    for (int i = 0; i < SENSOR_CTRL_MAX; i++) {
+        if (tuning.ctrl[i] != sensor_ctrl_default(i)) {
+            sensor_ctrl_set(i, tuning.ctrl[i]);
+        }
+    }
+    if (tuning.exposure_valid) {
+        sensor_ctrl_exposure_seed(s, &tuning.exposure);
+    }
+    ESP_LOGI(TAG, "Restored sensor tuning, exposure %d, gain %d", tuning.exposure.exposure, tuning.exposure.gain);
+}
+
+void camera_store_save_tuning(sensor_t *s)
+{
+    if (!s_nvs_open) {
+        return;
+    }
+    camera_store_tuning_t tuning;
+    memset(&tuning, 0, sizeof(tuning));
+    tuning.version = STORE_TUNING_VERSION;
+    tuning.pid = s->id.PID;
+    for (int i = 0; i < SENSOR_CTRL_MAX; i++) {
+        tuning.ctrl[i] = sensor_ctrl_get(i);
+    }
+    tuning.exposure_valid = sensor_ctrl_exposure_read(s, &tuning.exposure) == ESP_OK;
+
+    if (memcmp(&tuning, &s_saved_tuning, sizeof(tuning)) == 0) {
+        return;
+    }
+    if (nvs_set_blob(s_nvs, STORE_KEY_TUNING, &tuning, sizeof(tuning)) == ESP_OK && nvs_commit(s_nvs) == ESP_OK) {
+        s_saved_tuning = tuning;
+    } else {
+        ESP_LOGW(TAG, "Failed to store the sensor tuning");
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize NVS and open the webcam namespace
+ *
+ * The NVS partition is erased if it is full or was written by a newer NVS version.
+ */
+esp_err_t camera_store_init(void);
+
+/**
+ * @brief Last mode a host streamed
+ *
+ * @param mode_key UVC_MODE_KEY of the mode
+ * @return ESP_ERR_NVS_NOT_FOUND if no stream ran yet
+ */
+esp_err_t camera_store_load_mode(uint32_t *mode_key);
+
+/**
+ * @brief Remember the mode a host streams, flash is only written on a change
+ *
+ * @param mode_key UVC_MODE_KEY of the mode
+ */
+void camera_store_save_mode(uint32_t mode_key);
+
+/**
+ * @brief Re-apply the stored tuning to a freshly initialized sensor
+ *
+ * Image controls are queued through sensor_ctrl, the converged exposure is written
+ * right away. Tuning stored for another sensor model is ignored.
+ *
+ * @param s sensor handle
+ */
+void camera_store_restore(sensor_t *s);
+
+/**
+ * @brief Store the image controls and the converged exposure of the running sensor
+ *
+ * @param s sensor handle
+ */
+void camera_store_save_tuning(sensor_t *s);
+
+#ifdef __cplusplus
+}
+#endif
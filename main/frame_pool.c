@@ -0,0 +1,44 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <assert.h>
+#include "frame_pool.h"
+
+void frame_pool_init(frame_pool_t *pool, uint8_t size)
+{
+    assert(size > 0 && size <= FRAME_POOL_MAX_SLOTS);
+    pool->size = size;
+    atomic_init(&pool->busy, 0);
+}
+
+int frame_pool_acquire(frame_pool_t *pool)
+{
+    uint_least32_t busy = atomic_load_explicit(&pool->busy, memory_order_relaxed);
+    uint_least32_t all = pool->size == 32 ? UINT32_MAX : ((1UL << pool->size) - 1);
+
+    while ((busy & all) != all) {
+        int slot = __builtin_ctz(~busy);
+        if (atomic_compare_exchange_weak_explicit(&pool->busy, &busy, busy | (1UL << slot),
+                                                  memory_order_acquire, memory_order_relaxed)) {
+            return slot;
+        }
+        // busy was reloaded by the failed exchange, retry with the new mask
+    }
+    return -1;
+}
+
+void frame_pool_release(frame_pool_t *pool, int slot)
+{
+    assert(slot >= 0 && slot < pool->size);
+    uint_least32_t prev = atomic_fetch_and_explicit(&pool->busy, ~(1UL << slot), memory_order_release);
+    assert(prev & (1UL << slot));
+    (void)prev;
+}
+
+int frame_pool_in_flight(frame_pool_t *pool)
+{
+    return __builtin_popcount(atomic_load_explicit(&pool->busy, memory_order_relaxed));
+}
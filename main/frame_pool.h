@@ -0,0 +1,61 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAME_POOL_MAX_SLOTS    32
+
+/**
+ * @brief Lock-free allocator for a fixed number of frame slots
+ *
+ * The pool only hands out slot indexes, the caller keeps the slot storage in an
+ * array of the same size. Acquire and release may run concurrently from different
+ * tasks, a slot is claimed with a single compare-and-swap on the busy mask.
+ */
+typedef struct {
+    atomic_uint_least32_t busy; /*!< Bit n is set while slot n is lent out */
+    uint8_t size;               /*!< Number of slots, at most FRAME_POOL_MAX_SLOTS */
+} frame_pool_t;
+
+/**
+ * @brief Initialize a pool with all slots free
+ *
+ * @param pool pool instance
+ * @param size number of slots
+ */
+void frame_pool_init(frame_pool_t *pool, uint8_t size);
+
+/**
+ * @brief Claim a free slot
+ *
+ * @param pool pool instance
+ * @return slot index, or -1 if all slots are in flight
+ */
+int frame_pool_acquire(frame_pool_t *pool);
+
+/**
+ * @brief Give a slot back to the pool
+ *
+ * @param pool pool instance
+ * @param slot slot index returned by frame_pool_acquire
+ */
+void frame_pool_release(frame_pool_t *pool, int slot);
+
+/**
+ * @brief Number of slots currently in flight
+ */
+int frame_pool_in_flight(frame_pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,62 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAME_RING_SIZE     8   /*!< Capacity, must be a power of two */
+
+/**
+ * @brief Lock-free single-producer/single-consumer ring of frame pointers
+ *
+ * Exactly one task may push and exactly one task may pop. Each side only writes its
+ * own index, so no lock or compare-and-swap is needed, the release store of an index
+ * publishes the entry it covers to the other side.
+ */
+typedef struct {
+    void *items[FRAME_RING_SIZE];
+    atomic_uint head;   /*!< Next entry to write, only written by the producer */
+    atomic_uint tail;   /*!< Next entry to read, only written by the consumer */
+} frame_ring_t;
+
+/**
+ * @brief Initialize an empty ring
+ *
+ * @param ring ring instance
+ */
+void frame_ring_init(frame_ring_t *ring);
+
+/**
+ * @brief Append an entry, producer side only
+ *
+ * @param ring ring instance
+ * @param item entry to append
+ * @return false if the ring is full
+ */
+bool frame_ring_push(frame_ring_t *ring, void *item);
+
+/**
+ * @brief Remove the oldest entry, consumer side only
+ *
+ * @param ring ring instance
+ * @return oldest entry, or NULL if the ring is empty
+ */
+void *frame_ring_pop(frame_ring_t *ring);
+
+/**
+ * @brief Number of entries in the ring, exact only on the producer or consumer side
+ */
+unsigned frame_ring_count(frame_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
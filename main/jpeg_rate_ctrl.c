@@ -0,0 +1,88 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "jpeg_rate_ctrl.h"
+
+// Quality steps, in sensor units (0-63, higher means stronger compression)
+#define RATE_CTRL_STEP_OVER_BUDGET     1
+#define RATE_CTRL_STEP_OVER_LIMIT      4
+// Consecutive calm frames before the quality is improved again
+#define RATE_CTRL_RECOVER_FRAMES       8
+// Frames between a quality change and the first frame that reflects it
+#define RATE_CTRL_HOLDOFF_FRAMES       2
+
+void jpeg_rate_ctrl_init(jpeg_rate_ctrl_t *ctrl, uint32_t limit, int budget_percent, int base_quality, int worst_quality)
+{
+    memset(ctrl, 0, sizeof(*ctrl));
+    ctrl->limit = limit;
+    ctrl->budget = (uint32_t)((uint64_t)limit * budget_percent / 100);
+    ctrl->base_quality = base_quality;
+    ctrl->worst_quality = worst_quality > base_quality ? worst_quality : base_quality;
+    ctrl->quality = base_quality;
+}
+
+static int clamp_quality(const jpeg_rate_ctrl_t *ctrl, int quality)
+{
+    if (quality < ctrl->base_quality) {
+        return ctrl->base_quality;
+    }
+    if (quality > ctrl->worst_quality) {
+        return ctrl->worst_quality;
+    }
+    return quality;
+}
+
+int jpeg_rate_ctrl_update(jpeg_rate_ctrl_t *ctrl, uint32_t frame_len)
+{
+    int quality = ctrl->quality;
+    ctrl->frames++;
+
+    if (frame_len > ctrl->limit) {
+        // Too late for this frame, back off hard and start averaging from here
+        ctrl->dropped++;
+        ctrl->avg_len = frame_len;
+        ctrl->calm_frames = 0;
+        if (ctrl->holdoff == 0) {
+            quality += RATE_CTRL_STEP_OVER_LIMIT;
+        }
+    } else {
+        // JPEG size scales roughly with 1 / quantizer, estimate what the base quality would have produced
+        if (ctrl->quality > ctrl->base_quality && ctrl->base_quality > 0
+                && (uint64_t)frame_len * ctrl->quality / ctrl->base_quality > ctrl->limit) {
+            ctrl->avoided++;
+        }
+
+        // Exponential moving average with a weight of 1/4 for the newest frame
+        int32_t delta = (int32_t)frame_len - (int32_t)ctrl->avg_len;
+        ctrl->avg_len = (uint32_t)((int32_t)ctrl->avg_len + delta / 4);
+
+        if (frame_len > ctrl->budget || ctrl->avg_len > ctrl->budget) {
+            ctrl->calm_frames = 0;
+            if (ctrl->holdoff == 0) {
+                quality += RATE_CTRL_STEP_OVER_BUDGET;
+            }
+        } else if (ctrl->avg_len < ctrl->budget / 4 * 3) {
+            if (++ctrl->calm_frames >= RATE_CTRL_RECOVER_FRAMES) {
+                ctrl->calm_frames = 0;
+                quality--;
+            }
+        } else {
+            ctrl->calm_frames = 0;
+        }
+    }
+
+    if (ctrl->holdoff) {
+        ctrl->holdoff--;
+    }
+
+    quality = clamp_quality(ctrl, quality);
+    if (quality != ctrl->quality) {
+        ctrl->quality = quality;
+        ctrl->holdoff = RATE_CTRL_HOLDOFF_FRAMES;
+    }
+    return ctrl->quality;
+}
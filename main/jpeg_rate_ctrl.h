@@ -0,0 +1,60 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Closed-loop JPEG quality controller
+ *
+ * Watches the size of every compressed frame and nudges the sensor JPEG quality
+ * (0-63, lower is better) so that frames stay below a byte budget instead of
+ * overflowing the UVC transfer buffer. The controller has no dependency on the
+ * camera driver, the caller applies the returned quality through
+ * sensor_t::set_quality.
+ */
+typedef struct {
+    uint32_t limit;         /*!< Hard limit, frames larger than this are dropped */
+    uint32_t budget;        /*!< Target upper bound of the frame size */
+    int base_quality;       /*!< Quality requested for the current mode, never go better than this */
+    int worst_quality;      /*!< Worst quality the controller may fall back to */
+    int quality;            /*!< Quality currently applied to the sensor */
+    uint32_t avg_len;       /*!< Moving average of the frame size */
+    uint32_t calm_frames;   /*!< Consecutive frames well below the budget */
+    uint32_t holdoff;       /*!< Frames to wait before the last change is visible */
+    uint32_t frames;        /*!< Frames seen */
+    uint32_t dropped;       /*!< Frames that still exceeded the hard limit */
+    uint32_t avoided;       /*!< Frames that would have been dropped at the base quality */
+} jpeg_rate_ctrl_t;
+
+/**
+ * @brief Reset the controller for a newly negotiated mode
+ *
+ * @param ctrl controller instance
+ * @param limit hard frame size limit in bytes, usually the UVC buffer size
+ * @param budget_percent target frame size in percent of limit
+ * @param base_quality quality the mode starts with
+ * @param worst_quality worst quality the controller may use
+ */
+void jpeg_rate_ctrl_init(jpeg_rate_ctrl_t *ctrl, uint32_t limit, int budget_percent, int base_quality, int worst_quality);
+
+/**
+ * @brief Feed the size of a captured frame into the controller
+ *
+ * @param ctrl controller instance
+ * @param frame_len size of the compressed frame in bytes
+ * @return quality that should be applied to the sensor
+ */
+int jpeg_rate_ctrl_update(jpeg_rate_ctrl_t *ctrl, uint32_t frame_len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,230 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "bsp/esp-bsp.h"
+#include "eyes_display.h"
+#include "lcd_preview.h"
+
+static const char *TAG = "lcd_preview";
+
+#define PREVIEW_TASK_STACK      4096
+// Below the capture task and the USB stack, the preview only gets what they leave
+#define PREVIEW_TASK_PRIORITY   1
+#define PREVIEW_INTERVAL_US     (1000000 / CONFIG_CAMERA_LCD_PREVIEW_FPS)
+#define PREVIEW_JPEG_MAX        (CONFIG_CAMERA_LCD_PREVIEW_JPEG_MAX * 1024)
+#define PREVIEW_LOCK_MS         100
+
+typedef struct {
+    preview_src_t src;
+    const uint8_t *buf;
+    size_t len;
+    uint16_t width;
+    uint16_t height;
+    void *arg;
+} preview_job_t;
+
+static struct {
+    TaskHandle_t task;
+    lcd_preview_release_cb_t release;
+    preview_job_t job;
+    SemaphoreHandle_t hold_lock;    // Held by the task while it reads the offered frame
+    volatile bool busy;         // Set by an accepted offer, cleared once the frame was drawn
+    volatile bool holding;      // Set by an accepted offer, cleared once the frame was released
+    volatile bool stopped;      // Set by lcd_preview_stop, the task hides the preview
+    int64_t next_us;            // Earliest time the next frame is accepted
+    uint8_t *jpeg;              // Copy of the JPEG frame being decoded
+    preview_image_t img[2];     // Drawn and being scaled, swapped under the display lock
+    lv_img_dsc_t dsc[2];
+    int front;
+    lv_obj_t *obj;
+    lcd_preview_stats_t stats;
+} s_preview;
+
+static void lcd_preview_draw(int back)
+{
+    const preview_image_t *img = &s_preview.img[back];
+    lv_img_dsc_t *dsc = &s_preview.dsc[back];
+    if (!bsp_display_lock(PREVIEW_LOCK_MS)) {
+        return;
+    }
+    if (!s_preview.stopped) {
+        dsc->header.w = img->width;
+        dsc->header.h = img->height;
+        dsc->data_size = img->width * img->height * sizeof(uint16_t);
+        // The size may have changed with the stream mode
+        lv_img_cache_invalidate_src(dsc);
+        lv_img_set_src(s_preview.obj, dsc);
+        lv_obj_clear_flag(s_preview.obj, LV_OBJ_FLAG_HIDDEN);
+        // LVGL only reads the new front buffer from now on
+        s_preview.front = back;
+        s_preview.stats.shown++;
+    }
+    bsp_display_unlock();
+}
+
+// Only the task waits for LVGL, however long it renders
+static void lcd_preview_hide(void)
+{
+    bsp_display_lock(0);
+    if (s_preview.stopped) {
+        lv_obj_add_flag(s_preview.obj, LV_OBJ_FLAG_HIDDEN);
+    }
+    bsp_display_unlock();
+}
+
+static void lcd_preview_task(void *arg)
+{
+    (void)arg;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (s_preview.stopped) {
+            lcd_preview_hide();
+        }
+        xSemaphoreTake(s_preview.hold_lock, portMAX_DELAY);
+        if (!s_preview.holding) {
+            // Woken by lcd_preview_stop, which released the frame if there was one
+            xSemaphoreGive(s_preview.hold_lock);
+            continue;
+        }
+        int64_t start_us = esp_timer_get_time();
+        preview_job_t job = s_preview.job;
+        int back = s_preview.front ^ 1;
+        esp_err_t ret;
+
+        if (job.src == PREVIEW_SRC_JPEG) {
+            // Give the camera buffer back before the slow part
+            memcpy(s_preview.jpeg, job.buf, job.len);
+            s_preview.holding = false;
+            s_preview.release(job.arg);
+            xSemaphoreGive(s_preview.hold_lock);
+            ret = preview_scale(&s_preview.img[back], job.src, s_preview.jpeg, job.len, 0, 0);
+        } else {
+            // Sampling a raw frame costs about as much as copying it
+            ret = preview_scale(&s_preview.img[back], job.src, job.buf, job.len, job.width, job.height);
+            s_preview.holding = false;
+            s_preview.release(job.arg);
+            xSemaphoreGive(s_preview.hold_lock);
+        }
+        if (ret == ESP_OK) {
+            lcd_preview_draw(back);
+        } else {
+            s_preview.stats.failed++;
+            ESP_LOGD(TAG, "Frame not scaled: %s", esp_err_to_name(ret));
+        }
+
+        // Never busy more than half of the time, however slow a frame was to decode
+        int64_t busy_us = esp_timer_get_time() - start_us;
+        s_preview.stats.busy_us = busy_us;
+        s_preview.next_us = start_us + (2 * busy_us > PREVIEW_INTERVAL_US ? 2 * busy_us : PREVIEW_INTERVAL_US);
+        s_preview.busy = false;
+    }
+}
+
+esp_err_t lcd_preview_init(lcd_preview_release_cb_t release)
+{
+    s_preview.release = release;
+    s_preview.hold_lock = xSemaphoreCreateMutex();
+    s_preview.jpeg = heap_caps_malloc(PREVIEW_JPEG_MAX, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    for (int i = 0; i < 2; i++) {
+        s_preview.img[i] = (preview_image_t) {
+            .pixels = heap_caps_malloc(BSP_LCD_H_RES * BSP_LCD_V_RES * sizeof(uint16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT),
+            .max_width = BSP_LCD_H_RES,
+            .max_height = BSP_LCD_V_RES,
+            .swap_bytes = LV_COLOR_16_SWAP,
+        };
+        s_preview.dsc[i] = (lv_img_dsc_t) {
+            .header.cf = LV_IMG_CF_TRUE_COLOR,
+            .data = (const uint8_t *)s_preview.img[i].pixels,
+        };
+        if (!s_preview.img[i].pixels) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (!s_preview.jpeg || !s_preview.hold_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (!eyes_display_start()) {
+        return ESP_FAIL;
+    }
+    bsp_display_backlight_on();
+    bsp_display_lock(0);
+    lv_obj_t *scr = lv_scr_act();
+    lv_obj_clear_flag(scr, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_style_bg_color(scr, lv_color_black(), 0);
+    s_preview.obj = lv_img_create(scr);
+    lv_obj_align(s_preview.obj, LV_ALIGN_CENTER, 0, 0);
+    lv_obj_add_flag(s_preview.obj, LV_OBJ_FLAG_HIDDEN);
+    bsp_display_unlock();
+
+    // Any core, the priority already keeps it out of the way
+    if (xTaskCreatePinnedToCore(lcd_preview_task, "lcd_preview", PREVIEW_TASK_STACK, NULL,
+                                PREVIEW_TASK_PRIORITY, &s_preview.task, tskNO_AFFINITY) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "LCD preview up to %d fps, %dx%d", CONFIG_CAMERA_LCD_PREVIEW_FPS, BSP_LCD_H_RES, BSP_LCD_V_RES);
+    return ESP_OK;
+}
+
+bool lcd_preview_offer(preview_src_t src, const uint8_t *buf, size_t len, uint16_t width, uint16_t height, void *arg)
+{
+    if (!s_preview.task) {
+        return false;
+    }
+    if (s_preview.busy || esp_timer_get_time() < s_preview.next_us) {
+        s_preview.stats.skipped++;
+        return false;
+    }
+    if (src == PREVIEW_SRC_JPEG && len > PREVIEW_JPEG_MAX) {
+        s_preview.stats.failed++;
+        return false;
+    }
+    s_preview.job = (preview_job_t) {
+        .src = src,
+        .buf = buf,
+        .len = len,
+        .width = width,
+        .height = height,
+        .arg = arg,
+    };
+    s_preview.stopped = false;
+    s_preview.holding = true;
+    s_preview.busy = true;
+    xTaskNotifyGive(s_preview.task);
+    return true;
+}
+
+void lcd_preview_stop(void)
+{
+    if (!s_preview.task) {
+        return;
+    }
+    // Held for a copy or a raw frame scale only, a few milliseconds, the mutex lends the
+    // task the priority of the caller meanwhile
+    xSemaphoreTake(s_preview.hold_lock, portMAX_DELAY);
+    if (s_preview.holding) {
+        // The task did not start on the frame yet, hand it back from here
+        s_preview.holding = false;
+        s_preview.busy = false;
+        s_preview.release(s_preview.job.arg);
+    }
+    s_preview.stopped = true;
+    xSemaphoreGive(s_preview.hold_lock);
+    // The task hides the preview, also after a frame it is drawing now
+    xTaskNotifyGive(s_preview.task);
+}
+
+void lcd_preview_get_stats(lcd_preview_stats_t *stats)
+{
+    *stats = s_preview.stats;
+}
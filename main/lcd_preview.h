@@ -0,0 +1,77 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "preview_scale.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Called by the preview task once it no longer reads a frame it accepted
+ *
+ * @param arg arg of the lcd_preview_offer call that handed the frame over
+ */
+typedef void (*lcd_preview_release_cb_t)(void *arg);
+
+/**
+ * @brief Counters of the preview, cumulative since boot
+ */
+typedef struct {
+    uint32_t shown;         /*!< Frames drawn on the LCD */
+    uint32_t skipped;       /*!< Frames offered while the preview was busy or rate limited */
+    uint32_t failed;        /*!< Frames that could not be scaled, e.g. too large or not baseline JPEG */
+    uint32_t busy_us;       /*!< Time the last frame took to scale and draw */
+} lcd_preview_stats_t;
+
+/**
+ * @brief Start the display and the preview task
+ *
+ * @param release called when the preview is done with a frame it accepted
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if buffers or the task cannot be created
+ */
+esp_err_t lcd_preview_init(lcd_preview_release_cb_t release);
+
+/**
+ * @brief Offer a frame to the preview, never blocks
+ *
+ * The preview takes the frame if it finished the previous one and the frame rate limit
+ * allows another one, otherwise the frame is skipped. A JPEG frame is copied before it
+ * is released, a raw frame is released once it was scaled, both take a few milliseconds.
+ *
+ * @param src pixel layout of buf
+ * @param buf frame data, read by the preview task until release is called
+ * @param len frame size in bytes
+ * @param width frame width, unused for JPEG
+ * @param height frame height, unused for JPEG
+ * @param arg passed to release
+ * @return true if the preview took the frame, release will be called
+ */
+bool lcd_preview_offer(preview_src_t src, const uint8_t *buf, size_t len, uint16_t width, uint16_t height, void *arg);
+
+/**
+ * @brief Release the frame the preview holds, if any, and have the preview task hide it
+ *
+ * Never waits for the display lock. A frame the task did not start on yet is released
+ * right away, one it copies or scales now when it is done with it, in a few milliseconds.
+ * The preview is hidden by the task once LVGL lets it.
+ */
+void lcd_preview_stop(void);
+
+/**
+ * @brief Read the counters
+ */
+void lcd_preview_get_stats(lcd_preview_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
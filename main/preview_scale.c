@@ -0,0 +1,537 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "preview_scale.h"
+
+// Codes up to this length are decoded with a single table lookup
+#define HUFF_FAST_BITS      9
+// Baseline JPEG has two tables of each class
+#define HUFF_TABLES         2
+#define JPEG_MAX_COMPONENTS 3
+// Largest sampling factor and number of blocks in an MCU allowed by the standard
+#define JPEG_MAX_SAMPLING   4
+#define JPEG_MAX_MCU_BLOCKS 10
+
+typedef struct {
+    uint8_t fast_len[1 << HUFF_FAST_BITS];  // 0 if the code is longer than HUFF_FAST_BITS
+    uint8_t fast_sym[1 << HUFF_FAST_BITS];
+    int32_t maxcode[17];                    // Largest code of each length, -1 if there is none
+    int32_t delta[17];                      // Index into sym minus code, per length
+    uint8_t sym[256];
+    bool valid;
+} huff_table_t;
+
+typedef struct {
+    uint8_t id;
+    uint8_t h;
+    uint8_t v;
+    uint8_t tq;
+    uint8_t td;
+    uint8_t ta;
+    int pred;
+} jpeg_comp_t;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t ncomp;
+    uint8_t hmax;
+    uint8_t vmax;
+    uint16_t restart;
+    jpeg_comp_t comp[JPEG_MAX_COMPONENTS];
+    uint16_t qdc[4];                        // DC entry of each quantization table
+    huff_table_t dc[HUFF_TABLES];
+    huff_table_t ac[HUFF_TABLES];
+} jpeg_dc_t;
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t bits;                          // Next bits of the stream, MSB first
+    int count;
+} bit_reader_t;
+
+// Too large for the stack of the preview task, frames are scaled one at a time
+static jpeg_dc_t s_jpeg;
+
+static inline uint16_t ycc_to_rgb565(int y, int cb, int cr, bool swap)
+{
+    cb -= 128;
+    cr -= 128;
+    // JFIF full range, 16-bit fixed point
+    int r = y + ((91881 * cr + 32768) >> 16);
+    int g = y - ((22554 * cb + 46802 * cr - 32768) >> 16);
+    int b = y + ((116130 * cb + 32768) >> 16);
+    r = r < 0 ? 0 : (r > 255 ? 255 : r);
+    g = g < 0 ? 0 : (g > 255 ? 255 : g);
+    b = b < 0 ? 0 : (b > 255 ? 255 : b);
+    uint16_t c = (uint16_t)((r >> 3) << 11 | (g >> 2) << 5 | b >> 3);
+    return swap ? (uint16_t)(c >> 8 | c << 8) : c;
+}
+
+// Largest size with the aspect ratio of the source that fits the image
+static void preview_fit(preview_image_t *img, uint32_t src_w, uint32_t src_h)
+{
+    if (src_w * img->max_height >= src_h * img->max_width) {
+        img->width = img->max_width;
+        img->height = src_h * img->max_width / src_w;
+    } else {
+        img->height = img->max_height;
+        img->width = src_w * img->max_height / src_h;
+    }
+    img->width = img->width ? img->width : 1;
+    img->height = img->height ? img->height : 1;
+}
+
+static inline void br_fill(bit_reader_t *br)
+{
+    while (br->count <= 24) {
+        uint32_t byte = 0;
+        if (br->p < br->end) {
+            byte = *br->p;
+            if (byte != 0xff) {
+                br->p++;
+            } else if (br->p + 1 < br->end && br->p[1] == 0x00) {
+                // Stuffed byte
+                br->p += 2;
+            } else {
+                // A marker ends the segment, the reader stays on it and feeds zeros
+                byte = 0;
+            }
+        }
+        br->bits |= byte << (24 - br->count);
+        br->count += 8;
+    }
+}
+
+static inline uint32_t br_get(bit_reader_t *br, int n)
+{
+    br_fill(br);
+    uint32_t v = br->bits >> (32 - n);
+    br->bits <<= n;
+    br->count -= n;
+    return v;
+}
+
+static inline void br_skip(bit_reader_t *br, int n)
+{
+    br_fill(br);
+    br->bits <<= n;
+    br->count -= n;
+}
+
+// Continue after the next restart marker
+static void br_restart(bit_reader_t *br)
+{
+    const uint8_t *p = br->p;
+    while (p + 1 < br->end && !(p[0] == 0xff && (p[1] & 0xf8) == 0xd0)) {
+        p++;
+    }
+    br->p = p + 1 < br->end ? p + 2 : br->end;
+    br->bits = 0;
+    br->count = 0;
+}
+
+static inline int huff_decode(bit_reader_t *br, const huff_table_t *h)
+{
+    br_fill(br);
+    uint32_t look = br->bits >> (32 - HUFF_FAST_BITS);
+    int len = h->fast_len[look];
+    if (len) {
+        br->bits <<= len;
+        br->count -= len;
+        return h->fast_sym[look];
+    }
+    uint32_t code = br->bits >> 16;
+    for (len = HUFF_FAST_BITS + 1; len <= 16; len++) {
+        int32_t c = code >> (16 - len);
+        if (c <= h->maxcode[len]) {
+            br->bits <<= len;
+            br->count -= len;
+            return h->sym[c + h->delta[len]];
+        }
+    }
+    return -1;
+}
+
+static esp_err_t huff_build(huff_table_t *h, const uint8_t *counts, const uint8_t *sym, int nsym)
+{
+    memset(h->fast_len, 0, sizeof(h->fast_len));
+    int32_t code = 0;
+    int k = 0;
+    for (int len = 1; len <= 16; len++) {
+        h->delta[len] = k - code;
+        for (int i = 0; i < counts[len - 1]; i++, k++, code++) {
+            if (code >= (1 << len)) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            if (len <= HUFF_FAST_BITS) {
+                int shift = HUFF_FAST_BITS - len;
+                memset(&h->fast_len[code << shift], len, 1 << shift);
+                memset(&h->fast_sym[code << shift], sym[k], 1 << shift);
+            }
+        }
+        h->maxcode[len] = counts[len - 1] ? code - 1 : -1;
+        code <<= 1;
+    }
+    memcpy(h->sym, sym, nsym);
+    h->valid = true;
+    return ESP_OK;
+}
+
+// Decode one block, returns its average level or -1 if the data is corrupt
+static inline int jpeg_dc_block(jpeg_dc_t *j, bit_reader_t *br, jpeg_comp_t *c)
+{
+    int s = huff_decode(br, &j->dc[c->td]);
+    if (s < 0 || s > 11) {
+        return -1;
+    }
+    if (s) {
+        int v = br_get(br, s);
+        c->pred += v < (1 << (s - 1)) ? v - (1 << s) + 1 : v;
+    }
+
+    // The AC coefficients are only walked, not decoded
+    const huff_table_t *ac = &j->ac[c->ta];
+    for (int k = 1; k < 64;) {
+        br_fill(br);
+        uint32_t look = br->bits >> (32 - HUFF_FAST_BITS);
+        int len = ac->fast_len[look];
+        int rs;
+        if (len) {
+            rs = ac->fast_sym[look];
+            // At least 25 bits are buffered, enough for a short code and its value
+            len += rs & 15;
+            br->bits <<= len;
+            br->count -= len;
+        } else {
+            rs = huff_decode(br, ac);
+            if (rs < 0) {
+                return -1;
+            }
+            if (rs & 15) {
+                br_skip(br, rs & 15);
+            }
+        }
+        if ((rs & 15) == 0) {
+            if (rs != 0xf0) {
+                // End of block
+                break;
+            }
+            k += 16;
+        } else {
+            k += (rs >> 4) + 1;
+        }
+    }
+
+    // What the IDCT makes of a block with only the DC coefficient: its mean, level shifted
+    int level = ((c->pred * j->qdc[c->tq] + 4) >> 3) + 128;
+    return level < 0 ? 0 : (level > 255 ? 255 : level);
+}
+
+static esp_err_t jpeg_parse_sof(jpeg_dc_t *j, const uint8_t *s, size_t n)
+{
+    if (n < 6 || s[0] != 8) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    j->height = s[1] << 8 | s[2];
+    j->width = s[3] << 8 | s[4];
+    j->ncomp = s[5];
+    if (j->width == 0 || j->height == 0 || (j->ncomp != 1 && j->ncomp != 3)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (n < 6 + 3 * (size_t)j->ncomp) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    j->hmax = 1;
+    j->vmax = 1;
+    int blocks = 0;
+    for (int i = 0; i < j->ncomp; i++) {
+        jpeg_comp_t *c = &j->comp[i];
+        const uint8_t *d = s + 6 + 3 * i;
+        c->id = d[0];
+        // A single component is always coded block by block
+        c->h = j->ncomp == 1 ? 1 : d[1] >> 4;
+        c->v = j->ncomp == 1 ? 1 : d[1] & 15;
+        c->tq = d[2] & 3;
+        if (c->h == 0 || c->h > JPEG_MAX_SAMPLING || c->v == 0 || c->v > JPEG_MAX_SAMPLING) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        j->hmax = c->h > j->hmax ? c->h : j->hmax;
+        j->vmax = c->v > j->vmax ? c->v : j->vmax;
+        blocks += c->h * c->v;
+    }
+    if (blocks > JPEG_MAX_MCU_BLOCKS) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    for (int i = 0; i < j->ncomp; i++) {
+        if (j->hmax % j->comp[i].h || j->vmax % j->comp[i].v) {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t jpeg_parse_dht(jpeg_dc_t *j, const uint8_t *s, size_t n)
+{
+    while (n >= 17) {
+        int tc = s[0] >> 4;
+        int th = s[0] & 15;
+        int nsym = 0;
+        for (int i = 1; i <= 16; i++) {
+            nsym += s[i];
+        }
+        if (tc > 1 || th >= HUFF_TABLES) {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        if (nsym > 256 || n < 17 + (size_t)nsym) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        esp_err_t ret = huff_build(tc ? &j->ac[th] : &j->dc[th], s + 1, s + 17, nsym);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        s += 17 + nsym;
+        n -= 17 + nsym;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t jpeg_parse_dqt(jpeg_dc_t *j, const uint8_t *s, size_t n)
+{
+    while (n >= 65) {
+        int pq = s[0] >> 4;
+        size_t size = pq ? 129 : 65;
+        if (n < size) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        // Only the first entry, the DC quantizer, is needed
+        j->qdc[s[0] & 3] = pq ? (s[1] << 8 | s[2]) : s[1];
+        s += size;
+        n -= size;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t jpeg_parse_sos(jpeg_dc_t *j, const uint8_t *s, size_t n)
+{
+    if (j->ncomp == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    int ns = s[0];
+    if (n < 4 + 2 * (size_t)ns) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // Components in separate scans would have to be decoded scan by scan
+    if (ns != j->ncomp) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    for (int i = 0; i < ns; i++) {
+        int id = s[1 + 2 * i];
+        int tables = s[2 + 2 * i];
+        jpeg_comp_t *c = NULL;
+        for (int k = 0; k < j->ncomp; k++) {
+            if (j->comp[k].id == id) {
+                c = &j->comp[k];
+            }
+        }
+        // Scan order must follow frame order, which all baseline encoders do
+        if (c != &j->comp[i]) {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        c->td = tables >> 4;
+        c->ta = tables & 15;
+        if (c->td >= HUFF_TABLES || c->ta >= HUFF_TABLES || !j->dc[c->td].valid || !j->ac[c->ta].valid) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        c->pred = 0;
+    }
+    return ESP_OK;
+}
+
+// Walk the markers up to the start of the scan
+static esp_err_t jpeg_parse(jpeg_dc_t *j, const uint8_t *buf, size_t len, const uint8_t **scan)
+{
+    const uint8_t *p = buf;
+    const uint8_t *end = buf + len;
+    if (len < 4 || p[0] != 0xff || p[1] != 0xd8) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    p += 2;
+    while (end - p >= 4) {
+        if (p[0] != 0xff) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        uint8_t marker = p[1];
+        if (marker == 0xff) {
+            // Fill byte
+            p++;
+            continue;
+        }
+        size_t seg = p[2] << 8 | p[3];
+        if (seg < 2 || seg > (size_t)(end - p) - 2) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        const uint8_t *s = p + 4;
+        size_t n = seg - 2;
+        esp_err_t ret = ESP_OK;
+        switch (marker) {
+        case 0xc0:
+        case 0xc1:
+            ret = jpeg_parse_sof(j, s, n);
+            break;
+        case 0xc4:
+            ret = jpeg_parse_dht(j, s, n);
+            break;
+        case 0xdb:
+            ret = jpeg_parse_dqt(j, s, n);
+            break;
+        case 0xdd:
+            j->restart = n >= 2 ? (s[0] << 8 | s[1]) : 0;
+            break;
+        case 0xda:
+            ret = jpeg_parse_sos(j, s, n);
+            *scan = p + 2 + seg;
+            return ret;
+        default:
+            // Progressive, lossless and arithmetic coded frames
+            if (marker >= 0xc2 && marker <= 0xcf && marker != 0xc8 && marker != 0xcc) {
+                ret = ESP_ERR_NOT_SUPPORTED;
+            }
+            break;
+        }
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        p += 2 + seg;
+    }
+    return ESP_ERR_INVALID_SIZE;
+}
+
+static inline void preview_fill(preview_image_t *img, uint32_t x, uint32_t y, uint32_t src_w, uint32_t src_h, uint16_t color)
+{
+    uint32_t x0 = x * img->width / src_w;
+    uint32_t x1 = (x + 1) * img->width / src_w;
+    uint32_t y0 = y * img->height / src_h;
+    uint32_t y1 = (y + 1) * img->height / src_h;
+    for (uint32_t row = y0; row < y1; row++) {
+        uint16_t *dst = img->pixels + row * img->width;
+        for (uint32_t col = x0; col < x1; col++) {
+            dst[col] = color;
+        }
+    }
+}
+
+static esp_err_t jpeg_dc_scan(jpeg_dc_t *j, const uint8_t *p, const uint8_t *end, preview_image_t *img)
+{
+    // One pixel per 8x8 block of the full resolution component
+    uint32_t dc_w = (j->width + 7) / 8;
+    uint32_t dc_h = (j->height + 7) / 8;
+    uint32_t mcus_x = (dc_w + j->hmax - 1) / j->hmax;
+    uint32_t mcus_y = (dc_h + j->vmax - 1) / j->vmax;
+    bit_reader_t br = { .p = p, .end = end };
+    uint8_t level[JPEG_MAX_COMPONENTS][JPEG_MAX_SAMPLING * JPEG_MAX_SAMPLING];
+    int todo = j->restart;
+
+    preview_fit(img, dc_w, dc_h);
+    for (uint32_t my = 0; my < mcus_y; my++) {
+        for (uint32_t mx = 0; mx < mcus_x; mx++) {
+            if (j->restart) {
+                if (todo == 0) {
+                    br_restart(&br);
+                    for (int i = 0; i < j->ncomp; i++) {
+                        j->comp[i].pred = 0;
+                    }
+                    todo = j->restart;
+                }
+                todo--;
+            }
+            for (int i = 0; i < j->ncomp; i++) {
+                jpeg_comp_t *c = &j->comp[i];
+                for (int b = 0; b < c->h * c->v; b++) {
+                    int l = jpeg_dc_block(j, &br, c);
+                    if (l < 0) {
+                        return ESP_ERR_INVALID_SIZE;
+                    }
+                    level[i][b] = l;
+                }
+            }
+            // Chroma blocks cover hmax / h luma blocks
+            for (int py = 0; py < j->vmax; py++) {
+                uint32_t y = my * j->vmax + py;
+                if (y >= dc_h) {
+                    break;
+                }
+                for (int px = 0; px < j->hmax; px++) {
+                    uint32_t x = mx * j->hmax + px;
+                    if (x >= dc_w) {
+                        break;
+                    }
+                    const jpeg_comp_t *c = j->comp;
+                    int luma = level[0][py * c[0].v / j->vmax * c[0].h + px * c[0].h / j->hmax];
+                    uint16_t color;
+                    if (j->ncomp == 3) {
+                        int cb = level[1][py * c[1].v / j->vmax * c[1].h + px * c[1].h / j->hmax];
+                        int cr = level[2][py * c[2].v / j->vmax * c[2].h + px * c[2].h / j->hmax];
+                        color = ycc_to_rgb565(luma, cb, cr, img->swap_bytes);
+                    } else {
+                        color = ycc_to_rgb565(luma, 128, 128, img->swap_bytes);
+                    }
+                    preview_fill(img, x, y, dc_w, dc_h, color);
+                }
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t preview_scale_raw(preview_image_t *img, preview_src_t src, const uint8_t *buf, size_t len,
+                                   uint16_t width, uint16_t height)
+{
+    size_t bpp = src == PREVIEW_SRC_YUYV ? 2 : 1;
+    if (width == 0 || height == 0 || len < (size_t)width * height * bpp) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    preview_fit(img, width, height);
+    uint32_t step = ((uint32_t)width << 16) / img->width;
+    for (uint32_t y = 0; y < img->height; y++) {
+        const uint8_t *row = buf + (size_t)(y * height / img->height) * width * bpp;
+        uint16_t *dst = img->pixels + y * img->width;
+        uint32_t sx = 0;
+        if (src == PREVIEW_SRC_YUYV) {
+            for (uint32_t x = 0; x < img->width; x++, sx += step) {
+                uint32_t i = sx >> 16;
+                // Each pair of pixels shares U and V: Y0 U Y1 V
+                const uint8_t *pair = row + (i & ~1u) * 2;
+                dst[x] = ycc_to_rgb565(row[i * 2], pair[1], pair[3], img->swap_bytes);
+            }
+        } else {
+            for (uint32_t x = 0; x < img->width; x++, sx += step) {
+                dst[x] = ycc_to_rgb565(row[sx >> 16], 128, 128, img->swap_bytes);
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t preview_scale(preview_image_t *img, preview_src_t src, const uint8_t *buf, size_t len,
+                        uint16_t width, uint16_t height)
+{
+    if (src != PREVIEW_SRC_JPEG) {
+        return preview_scale_raw(img, src, buf, len, width, height);
+    }
+    jpeg_dc_t *j = &s_jpeg;
+    const uint8_t *scan = NULL;
+    // Tables may be defined once and reused by later frames, as in abbreviated streams
+    j->ncomp = 0;
+    j->restart = 0;
+    esp_err_t ret = jpeg_parse(j, buf, len, &scan);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return jpeg_dc_scan(j, scan, buf + len, img);
+}
@@ -0,0 +1,64 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Pixel layout of a frame to preview
+ */
+typedef enum {
+    PREVIEW_SRC_JPEG = 0,   /*!< Baseline JPEG, the size is taken from the frame header */
+    PREVIEW_SRC_YUYV,       /*!< Packed YUV422, 2 bytes per pixel */
+    PREVIEW_SRC_GRAY,       /*!< Luma only, 1 byte per pixel */
+} preview_src_t;
+
+/**
+ * @brief RGB565 image a frame is scaled into
+ *
+ * The frame is scaled to the largest size that fits max_width x max_height and keeps
+ * its aspect ratio, with nearest neighbour sampling.
+ */
+typedef struct {
+    uint16_t *pixels;       /*!< Room for max_width * max_height pixels */
+    uint16_t max_width;
+    uint16_t max_height;
+    bool swap_bytes;        /*!< Store pixels byte-swapped, as LVGL expects with LV_COLOR_16_SWAP */
+    uint16_t width;         /*!< Size of the last scaled frame, rows are width pixels apart */
+    uint16_t height;
+} preview_image_t;
+
+/**
+ * @brief Scale a camera frame down to a preview image
+ *
+ * JPEG frames are not fully decoded: the Huffman data is walked to find the DC
+ * coefficient of each block, which is the average of its 8x8 pixels, and AC
+ * coefficients are skipped without dequantization or IDCT. The result is the frame
+ * at 1/8 scale, which is then scaled to fit the image.
+ *
+ * @param img output image
+ * @param src pixel layout of buf
+ * @param buf frame data
+ * @param len frame size in bytes
+ * @param width frame width, unused for JPEG
+ * @param height frame height, unused for JPEG
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED for JPEG frames that are not baseline
+ *         8-bit Huffman, ESP_ERR_INVALID_SIZE if the frame is truncated or corrupt
+ */
+esp_err_t preview_scale(preview_image_t *img, preview_src_t src, const uint8_t *buf, size_t len,
+                        uint16_t width, uint16_t height);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,221 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "esp_log.h"
+#include "sensor_ctrl.h"
+
+static const char *TAG = "sensor_ctrl";
+
+// OV2640 sensor bank registers, bit 8 of the address selects the bank in get_reg/set_reg
+#define OV2640_SENSOR_BANK      0x100
+#define OV2640_GAIN             (OV2640_SENSOR_BANK | 0x00)
+#define OV2640_REG04            (OV2640_SENSOR_BANK | 0x04)    /*!< AEC[1:0] */
+#define OV2640_AEC              (OV2640_SENSOR_BANK | 0x10)    /*!< AEC[9:2] */
+#define OV2640_COM8             (OV2640_SENSOR_BANK | 0x13)    /*!< Bit 2 AGC enable, bit 0 AEC enable */
+#define OV2640_REG45            (OV2640_SENSOR_BANK | 0x45)    /*!< AEC[15:10] */
+#define OV2640_COM8_AUTO        0x05
+#define OV2640_COM2             (OV2640_SENSOR_BANK | 0x09)    /*!< Bit 4 standby */
+#define OV2640_COM2_STANDBY     0x10
+// OV3660/OV5640 SYSTEM CTROL0, bit 6 software power down
+#define OV3660_SYSTEM_CTROL0    0x3008
+#define OV3660_POWER_DOWN       0x40
+
+#define CT  SENSOR_CTRL_UVC_UNIT_CT
+#define PU  SENSOR_CTRL_UVC_UNIT_PU
+#define XU  SENSOR_CTRL_UVC_UNIT_XU
+#define NO  SENSOR_CTRL_UVC_UNIT_NONE
+
+static const sensor_ctrl_info_t s_info[SENSOR_CTRL_MAX] = {
+    [SENSOR_CTRL_BRIGHTNESS]    = {"brightness",    -2, 2,    PU, PU_BRIGHTNESS_CONTROL},
+    [SENSOR_CTRL_CONTRAST]      = {"contrast",      -2, 2,    PU, PU_CONTRAST_CONTROL},
+    [SENSOR_CTRL_SATURATION]    = {"saturation",    -2, 2,    PU, PU_SATURATION_CONTROL},
+    [SENSOR_CTRL_SHARPNESS]     = {"sharpness",     -2, 2,    PU, PU_SHARPNESS_CONTROL},
+    [SENSOR_CTRL_AUTO_EXPOSURE] = {"auto exposure",  0, 1,    CT, CT_AE_MODE_CONTROL},
+    [SENSOR_CTRL_EXPOSURE]      = {"exposure",       0, 1200, XU, XU_EXPOSURE_LINES_CONTROL},
+    [SENSOR_CTRL_AUTO_GAIN]     = {"auto gain",      0, 1,    NO, 0},
+    [SENSOR_CTRL_GAIN]          = {"gain",           0, 30,   PU, PU_GAIN_CONTROL},
+    [SENSOR_CTRL_AUTO_WB]       = {"auto white balance", 0, 1, PU, PU_WHITE_BALANCE_TEMPERATURE_AUTO_CONTROL},
+    [SENSOR_CTRL_WB_MODE]       = {"white balance mode", 0, 4, NO, 0},
+    [SENSOR_CTRL_HFLIP]         = {"hflip",          0, 1,    XU, XU_HFLIP_CONTROL},
+    [SENSOR_CTRL_VFLIP]         = {"vflip",          0, 1,    XU, XU_VFLIP_CONTROL},
+};
+
+#define SENSOR_CTRL_ALL     ((1UL << SENSOR_CTRL_MAX) - 1)
+
+// Values are written by any task, the capture task applies them, the dirty mask orders both
+static atomic_int s_value[SENSOR_CTRL_MAX];
+static int16_t s_default[SENSOR_CTRL_MAX];
+static atomic_uint_least32_t s_dirty;
+static bool s_attached;
+
+const sensor_ctrl_info_t *sensor_ctrl_info(sensor_ctrl_id_t id)
+{
+    return id < SENSOR_CTRL_MAX ? &s_info[id] : NULL;
+}
+
+int sensor_ctrl_find_uvc(uint8_t unit, uint8_t selector)
+{
+    for (int i = 0; i < SENSOR_CTRL_MAX; i++) {
+        if (s_info[i].uvc_unit == unit && s_info[i].uvc_selector == selector && unit != NO) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int sensor_ctrl_read(const camera_status_t *st, sensor_ctrl_id_t id)
+{
+    switch (id) {
+    case SENSOR_CTRL_BRIGHTNESS:    return st->brightness;
+    case SENSOR_CTRL_CONTRAST:      return st->contrast;
+    case SENSOR_CTRL_SATURATION:    return st->saturation;
+    case SENSOR_CTRL_SHARPNESS:     return st->sharpness;
+    case SENSOR_CTRL_AUTO_EXPOSURE: return st->aec;
+    case SENSOR_CTRL_EXPOSURE:      return st->aec_value;
+    case SENSOR_CTRL_AUTO_GAIN:     return st->agc;
+    case SENSOR_CTRL_GAIN:          return st->agc_gain;
+    case SENSOR_CTRL_AUTO_WB:       return st->awb;
+    case SENSOR_CTRL_WB_MODE:       return st->wb_mode;
+    case SENSOR_CTRL_HFLIP:         return st->hmirror;
+    case SENSOR_CTRL_VFLIP:         return st->vflip;
+    default:                        return 0;
+    }
+}
+
+static int sensor_ctrl_write(sensor_t *s, sensor_ctrl_id_t id, int value)
+{
+    switch (id) {
+    case SENSOR_CTRL_BRIGHTNESS:    return s->set_brightness(s, value);
+    case SENSOR_CTRL_CONTRAST:      return s->set_contrast(s, value);
+    case SENSOR_CTRL_SATURATION:    return s->set_saturation(s, value);
+    case SENSOR_CTRL_SHARPNESS:     return s->set_sharpness(s, value);
+    case SENSOR_CTRL_AUTO_EXPOSURE: return s->set_exposure_ctrl(s, value);
+    case SENSOR_CTRL_EXPOSURE:      return s->set_aec_value(s, value);
+    case SENSOR_CTRL_AUTO_GAIN:     return s->set_gain_ctrl(s, value);
+    case SENSOR_CTRL_GAIN:          return s->set_agc_gain(s, value);
+    case SENSOR_CTRL_AUTO_WB:       return s->set_whitebal(s, value);
+    case SENSOR_CTRL_WB_MODE:       return s->set_wb_mode(s, value);
+    case SENSOR_CTRL_HFLIP:         return s->set_hmirror(s, value);
+    case SENSOR_CTRL_VFLIP:         return s->set_vflip(s, value);
+    default:                        return -1;
+    }
+}
+
+void sensor_ctrl_attach(sensor_t *s)
+{
+    if (s_attached) {
+        // A restarted driver starts from the sensor defaults again
+        atomic_fetch_or_explicit(&s_dirty, SENSOR_CTRL_ALL, memory_order_release);
+        return;
+    }
+    for (int i = 0; i < SENSOR_CTRL_MAX; i++) {
+        s_default[i] = sensor_ctrl_read(&s->status, i);
+        // Values requested before the sensor came up win over its defaults
+        if (!(atomic_load_explicit(&s_dirty, memory_order_acquire) & (1UL << i))) {
+            atomic_store_explicit(&s_value[i], s_default[i], memory_order_relaxed);
+        }
+    }
+    s_attached = true;
+}
+
+esp_err_t sensor_ctrl_set(sensor_ctrl_id_t id, int value)
+{
+    if (id >= SENSOR_CTRL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (value < s_info[id].min) {
+        value = s_info[id].min;
+    } else if (value > s_info[id].max) {
+        value = s_info[id].max;
+    }
+    atomic_store_explicit(&s_value[id], value, memory_order_relaxed);
+    atomic_fetch_or_explicit(&s_dirty, 1UL << id, memory_order_release);
+    return ESP_OK;
+}
+
+int sensor_ctrl_get(sensor_ctrl_id_t id)
+{
+    return id < SENSOR_CTRL_MAX ? atomic_load_explicit(&s_value[id], memory_order_relaxed) : 0;
+}
+
+int sensor_ctrl_default(sensor_ctrl_id_t id)
+{
+    return id < SENSOR_CTRL_MAX ? s_default[id] : 0;
+}
+
+int sensor_ctrl_apply(sensor_t *s)
+{
+    uint_least32_t dirty = atomic_exchange_explicit(&s_dirty, 0, memory_order_acquire);
+    int written = 0;
+
+    while (dirty) {
+        sensor_ctrl_id_t id = __builtin_ctz(dirty);
+        dirty &= dirty - 1;
+        int value = atomic_load_explicit(&s_value[id], memory_order_relaxed);
+        if (sensor_ctrl_write(s, id, value) != 0) {
+            // Not every sensor implements every control
+            ESP_LOGD(TAG, "%s not supported by this sensor", s_info[id].name);
+            continue;
+        }
+        written++;
+    }
+    return written;
+}
+
+esp_err_t sensor_ctrl_exposure_read(sensor_t *s, sensor_ctrl_exposure_t *out)
+{
+    if (s->id.PID != OV2640_PID) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    int reg45 = s->get_reg(s, OV2640_REG45, 0x3f);
+    int aec = s->get_reg(s, OV2640_AEC, 0xff);
+    int reg04 = s->get_reg(s, OV2640_REG04, 0x03);
+    int gain = s->get_reg(s, OV2640_GAIN, 0xff);
+    if (reg45 < 0 || aec < 0 || reg04 < 0 || gain < 0) {
+        return ESP_FAIL;
+    }
+    out->exposure = (uint16_t)((reg45 << 10) | (aec << 2) | reg04);
+    out->gain = (uint8_t)gain;
+    return ESP_OK;
+}
+
+esp_err_t sensor_ctrl_exposure_seed(sensor_t *s, const sensor_ctrl_exposure_t *exposure)
+{
+    if (s->id.PID != OV2640_PID) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    int com8 = s->get_reg(s, OV2640_COM8, 0xff);
+    if (com8 < 0) {
+        return ESP_FAIL;
+    }
+    // Hold the loops so they do not overwrite the values before the next frame
+    int ret = s->set_reg(s, OV2640_COM8, OV2640_COM8_AUTO, 0);
+    ret |= s->set_reg(s, OV2640_REG45, 0x3f, exposure->exposure >> 10);
+    ret |= s->set_reg(s, OV2640_AEC, 0xff, (exposure->exposure >> 2) & 0xff);
+    ret |= s->set_reg(s, OV2640_REG04, 0x03, exposure->exposure & 0x03);
+    ret |= s->set_reg(s, OV2640_GAIN, 0xff, exposure->gain);
+    ret |= s->set_reg(s, OV2640_COM8, OV2640_COM8_AUTO, com8);
+    return ret ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t sensor_ctrl_standby(sensor_t *s, bool standby)
+{
+    int ret;
+    switch (s->id.PID) {
+    case OV2640_PID:
+        ret = s->set_reg(s, OV2640_COM2, OV2640_COM2_STANDBY, standby ? OV2640_COM2_STANDBY : 0);
+        break;
+    case OV3660_PID:
+    case OV5640_PID:
+        ret = s->set_reg(s, OV3660_SYSTEM_CTROL0, OV3660_POWER_DOWN, standby ? OV3660_POWER_DOWN : 0);
+        break;
+    default:
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return ret ? ESP_FAIL : ESP_OK;
+}
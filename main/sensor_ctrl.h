@@ -0,0 +1,173 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Image controls applied live through sensor_t
+ */
+typedef enum {
+    SENSOR_CTRL_BRIGHTNESS = 0,
+    SENSOR_CTRL_CONTRAST,
+    SENSOR_CTRL_SATURATION,
+    SENSOR_CTRL_SHARPNESS,
+    SENSOR_CTRL_AUTO_EXPOSURE,
+    SENSOR_CTRL_EXPOSURE,
+    SENSOR_CTRL_AUTO_GAIN,
+    SENSOR_CTRL_GAIN,
+    SENSOR_CTRL_AUTO_WB,
+    SENSOR_CTRL_WB_MODE,
+    SENSOR_CTRL_HFLIP,
+    SENSOR_CTRL_VFLIP,
+    SENSOR_CTRL_MAX,
+} sensor_ctrl_id_t;
+
+/* UVC 1.1 units and control selectors, see sensor_ctrl_find_uvc() */
+#define SENSOR_CTRL_UVC_UNIT_NONE   0
+#define SENSOR_CTRL_UVC_UNIT_CT     1   /*!< Camera Terminal */
+#define SENSOR_CTRL_UVC_UNIT_PU     2   /*!< Processing Unit */
+#define SENSOR_CTRL_UVC_UNIT_XU     3   /*!< Vendor Extension Unit, for controls without a standard one */
+
+/* UVC 1.1 control selectors of the controls mapped to a unit */
+#define CT_AE_MODE_CONTROL                          0x02
+#define PU_BRIGHTNESS_CONTROL                       0x02
+#define PU_CONTRAST_CONTROL                         0x03
+#define PU_GAIN_CONTROL                             0x04
+#define PU_SATURATION_CONTROL                       0x07
+#define PU_SHARPNESS_CONTROL                        0x08
+#define PU_WHITE_BALANCE_TEMPERATURE_AUTO_CONTROL   0x0B
+
+/*
+ * Extension Unit selectors, next to the telemetry one (UVC_TELEMETRY_XU_SELECTOR). The
+ * exposure is in sensor lines, which have no fixed duration across frame sizes and clocks,
+ * so it cannot be the 100 us units of CT_EXPOSURE_TIME_ABSOLUTE_CONTROL.
+ */
+#define XU_EXPOSURE_LINES_CONTROL                   0x02
+#define XU_HFLIP_CONTROL                            0x03
+#define XU_VFLIP_CONTROL                            0x04
+
+/**
+ * @brief Static description of a control
+ */
+typedef struct {
+    const char *name;       /*!< Control name */
+    int16_t min;            /*!< Smallest value the sensor accepts */
+    int16_t max;            /*!< Largest value the sensor accepts */
+    uint8_t uvc_unit;       /*!< SENSOR_CTRL_UVC_UNIT_x the control maps to */
+    uint8_t uvc_selector;   /*!< Control selector within that unit, 0 if there is no standard control */
+} sensor_ctrl_info_t;
+
+/**
+ * @brief Description of a control
+ */
+const sensor_ctrl_info_t *sensor_ctrl_info(sensor_ctrl_id_t id);
+
+/**
+ * @brief Control mapped to a UVC control selector
+ *
+ * @param unit SENSOR_CTRL_UVC_UNIT_CT, SENSOR_CTRL_UVC_UNIT_PU or SENSOR_CTRL_UVC_UNIT_XU
+ * @param selector UVC control selector
+ * @return control id, or -1 if the selector is not supported
+ */
+int sensor_ctrl_find_uvc(uint8_t unit, uint8_t selector);
+
+/**
+ * @brief Take over a freshly initialized sensor
+ *
+ * The first call loads the current sensor settings as control values and defaults.
+ * Later calls, after the driver was restarted, mark every control for re-application
+ * so that the sensor gets the values set before the restart back.
+ *
+ * @param s sensor handle
+ */
+void sensor_ctrl_attach(sensor_t *s);
+
+/**
+ * @brief Request a control value, may be called from any task
+ *
+ * The value is clamped to the range of the control and only stored, the sensor is
+ * written by the next sensor_ctrl_apply() between two frames.
+ *
+ * @param id control
+ * @param value requested value
+ * @return ESP_ERR_INVALID_ARG for an unknown control
+ */
+esp_err_t sensor_ctrl_set(sensor_ctrl_id_t id, int value);
+
+/**
+ * @brief Current value of a control, including changes not yet applied
+ */
+int sensor_ctrl_get(sensor_ctrl_id_t id);
+
+/**
+ * @brief Value of a control when the sensor was first attached
+ */
+int sensor_ctrl_default(sensor_ctrl_id_t id);
+
+/**
+ * @brief Write all changed controls to the sensor
+ *
+ * Called by the capture task between two frames, so a batch of changes lands in the
+ * same frame and never restarts the driver.
+ *
+ * @param s sensor handle
+ * @return number of controls written
+ */
+int sensor_ctrl_apply(sensor_t *s);
+
+/**
+ * @brief Exposure and gain the sensor's auto loops converged to
+ */
+typedef struct {
+    uint16_t exposure;  /*!< Exposure in sensor lines */
+    uint8_t gain;       /*!< Raw analog gain register */
+} sensor_ctrl_exposure_t;
+
+/**
+ * @brief Read the exposure and gain the automatic controls currently use
+ *
+ * @param s sensor handle
+ * @param out converged values
+ * @return ESP_ERR_NOT_SUPPORTED for sensors other than the OV2640
+ */
+esp_err_t sensor_ctrl_exposure_read(sensor_t *s, sensor_ctrl_exposure_t *out);
+
+/**
+ * @brief Start the automatic controls from previously converged values
+ *
+ * The values are written with the automatic controls held, which then continue from
+ * there instead of from the sensor's reset values.
+ *
+ * @param s sensor handle
+ * @param exposure values from sensor_ctrl_exposure_read()
+ * @return ESP_ERR_NOT_SUPPORTED for sensors other than the OV2640
+ */
+esp_err_t sensor_ctrl_exposure_seed(sensor_t *s, const sensor_ctrl_exposure_t *exposure);
+
+/**
+ * @brief Put the sensor into or out of its software standby
+ *
+ * Registers are kept in standby, so the sensor resumes with its settings and its
+ * last exposure. Nothing is captured while it sleeps.
+ *
+ * @param s sensor handle
+ * @param standby true to stop the sensor, false to wake it
+ * @return ESP_ERR_NOT_SUPPORTED for sensors without a known standby bit
+ */
+esp_err_t sensor_ctrl_standby(sensor_t *s, bool standby);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,145 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdatomic.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "stream_stats.h"
+
+static const char *TAG = "stream_stats";
+
+static const char *lat_names[STREAM_STATS_LAT_MAX] = {
+    "capture",
+    "fb_get wait",
+    "USB hold",
+};
+
+// Every counter has a single writer task, relaxed atomics only keep each value untorn
+static struct {
+    atomic_uint_least32_t captured;
+    atomic_uint_least32_t sent;
+    atomic_uint_least32_t empty;
+    atomic_uint_least32_t dropped[STREAM_STATS_DROP_MAX];
+    atomic_uint_least32_t bytes;
+    atomic_uint_least32_t peak_len;
+    atomic_uint_least32_t hist[STREAM_STATS_LAT_MAX][STREAM_STATS_BUCKETS];
+} s_stats;
+
+static inline void counter_add(atomic_uint_least32_t *counter, uint32_t n)
+{
+    atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+}
+
+void stream_stats_captured(void)
+{
+    counter_add(&s_stats.captured, 1);
+}
+
+void stream_stats_sent(uint32_t len)
+{
+    counter_add(&s_stats.sent, 1);
+    counter_add(&s_stats.bytes, len);
+
+    // The reporter resets the peak, so this is not the only writer
+    uint_least32_t peak = atomic_load_explicit(&s_stats.peak_len, memory_order_relaxed);
+    while (len > peak && !atomic_compare_exchange_weak_explicit(&s_stats.peak_len, &peak, len,
+                                                                memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void stream_stats_empty(void)
+{
+    counter_add(&s_stats.empty, 1);
+}
+
+void stream_stats_dropped(stream_stats_drop_t reason)
+{
+    counter_add(&s_stats.dropped[reason], 1);
+}
+
+void stream_stats_latency(stream_stats_lat_t lat, uint32_t us)
+{
+    int bucket = us ? 32 - __builtin_clz(us) : 0;
+    if (bucket >= STREAM_STATS_BUCKETS) {
+        bucket = STREAM_STATS_BUCKETS - 1;
+    }
+    counter_add(&s_stats.hist[lat][bucket], 1);
+}
+
+void stream_stats_snapshot(stream_stats_t *out)
+{
+    out->captured = atomic_load_explicit(&s_stats.captured, memory_order_relaxed);
+    out->sent = atomic_load_explicit(&s_stats.sent, memory_order_relaxed);
+    out->empty = atomic_load_explicit(&s_stats.empty, memory_order_relaxed);
+    for (int i = 0; i < STREAM_STATS_DROP_MAX; i++) {
+        out->dropped[i] = atomic_load_explicit(&s_stats.dropped[i], memory_order_relaxed);
+    }
+    out->bytes = atomic_load_explicit(&s_stats.bytes, memory_order_relaxed);
+    out->peak_len = atomic_exchange_explicit(&s_stats.peak_len, 0, memory_order_relaxed);
+    for (int i = 0; i < STREAM_STATS_LAT_MAX; i++) {
+        for (int b = 0; b < STREAM_STATS_BUCKETS; b++) {
+            out->hist[i][b] = atomic_load_explicit(&s_stats.hist[i][b], memory_order_relaxed);
+        }
+    }
+}
+
+uint32_t stream_stats_percentile(const stream_stats_t *cur, const stream_stats_t *prev, stream_stats_lat_t lat, int percent)
+{
+    uint32_t total = 0;
+    for (int b = 0; b < STREAM_STATS_BUCKETS; b++) {
+        total += cur->hist[lat][b] - prev->hist[lat][b];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint32_t target = (uint32_t)(((uint64_t)total * percent + 99) / 100);
+    uint32_t seen = 0;
+    for (int b = 0; b < STREAM_STATS_BUCKETS; b++) {
+        seen += cur->hist[lat][b] - prev->hist[lat][b];
+        if (seen >= target) {
+            return 1UL << b;
+        }
+    }
+    return 1UL << (STREAM_STATS_BUCKETS - 1);
+}
+
+void stream_stats_report(const stream_stats_t *cur, const stream_stats_t *prev, int64_t elapsed_us, int requested_fps)
+{
+    uint32_t sent = cur->sent - prev->sent;
+    if (sent == 0 && cur->captured == prev->captured) {
+        return;
+    }
+    if (elapsed_us <= 0) {
+        elapsed_us = 1;
+    }
+    uint32_t bytes = cur->bytes - prev->bytes;
+    uint32_t fps_x10 = (uint32_t)((uint64_t)sent * 10000000 / elapsed_us);
+    uint32_t kbps = (uint32_t)((uint64_t)bytes * 8000 / elapsed_us);
+
+    ESP_LOGI(TAG, "%"PRIu32".%"PRIu32" fps (requested %d), %"PRIu32" kbit/s, frame avg %"PRIu32" peak %"PRIu32" bytes",
+             fps_x10 / 10, fps_x10 % 10, requested_fps, kbps, sent ? bytes / sent : 0, cur->peak_len);
+    ESP_LOGI(TAG, "captured %"PRIu32", sent %"PRIu32", dropped %"PRIu32" oversize %"PRIu32" superseded, %"PRIu32" empty fb_get",
+             cur->captured - prev->captured, sent, cur->dropped[STREAM_STATS_DROP_OVERSIZE] - prev->dropped[STREAM_STATS_DROP_OVERSIZE],
+             cur->dropped[STREAM_STATS_DROP_SUPERSEDED] - prev->dropped[STREAM_STATS_DROP_SUPERSEDED], cur->empty - prev->empty);
+
+    for (int i = 0; i < STREAM_STATS_LAT_MAX; i++) {
+        uint32_t total = 0;
+        int top = 0;
+        for (int b = 0; b < STREAM_STATS_BUCKETS; b++) {
+            uint32_t n = cur->hist[i][b] - prev->hist[i][b];
+            total += n;
+            if (n) {
+                top = b;
+            }
+        }
+        if (total == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "%s latency: p50 < %"PRIu32" us, p99 < %"PRIu32" us, max < %"PRIu32" us (%"PRIu32" samples)",
+                 lat_names[i], stream_stats_percentile(cur, prev, i, 50),
+                 stream_stats_percentile(cur, prev, i, 99), (uint32_t)1 << top, total);
+    }
+}
@@ -0,0 +1,113 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bucket n counts samples in [2^(n-1), 2^n) us, the last one everything above */
+#define STREAM_STATS_BUCKETS    20
+
+/**
+ * @brief Latencies tracked in log2 histograms
+ */
+typedef enum {
+    STREAM_STATS_LAT_CAPTURE = 0,   /*!< End of the sensor capture to the hand-off to UVC */
+    STREAM_STATS_LAT_WAIT,          /*!< Time fb_get_cb spent waiting for a frame */
+    STREAM_STATS_LAT_HOLD,          /*!< Hand-off to UVC until the frame was returned */
+    STREAM_STATS_LAT_MAX,
+} stream_stats_lat_t;
+
+/**
+ * @brief Reasons a captured frame was not sent
+ */
+typedef enum {
+    STREAM_STATS_DROP_OVERSIZE = 0, /*!< Larger than the transfer buffer of the mode */
+    STREAM_STATS_DROP_SUPERSEDED,   /*!< Replaced by a newer frame before UVC asked for it */
+    STREAM_STATS_DROP_MAX,
+} stream_stats_drop_t;
+
+/**
+ * @brief Copy of the counters, all cumulative since boot except peak_len
+ */
+typedef struct {
+    uint32_t captured;                          /*!< Frames taken from the driver */
+    uint32_t sent;                              /*!< Frames handed to UVC */
+    uint32_t empty;                             /*!< fb_get_cb calls that found no frame */
+    uint32_t dropped[STREAM_STATS_DROP_MAX];    /*!< Frames not sent, by reason */
+    uint32_t bytes;                             /*!< Payload bytes handed to UVC, wraps */
+    uint32_t peak_len;                          /*!< Largest frame since the previous snapshot */
+    uint32_t hist[STREAM_STATS_LAT_MAX][STREAM_STATS_BUCKETS];
+} stream_stats_t;
+
+/**
+ * @brief Count a frame taken from the driver
+ */
+void stream_stats_captured(void);
+
+/**
+ * @brief Count a frame handed to UVC
+ *
+ * @param len payload size in bytes
+ */
+void stream_stats_sent(uint32_t len);
+
+/**
+ * @brief Count an fb_get_cb call that had no frame to return
+ */
+void stream_stats_empty(void);
+
+/**
+ * @brief Count a frame that was captured but not sent
+ */
+void stream_stats_dropped(stream_stats_drop_t reason);
+
+/**
+ * @brief Add a latency sample
+ *
+ * @param lat histogram to update
+ * @param us latency in microseconds
+ */
+void stream_stats_latency(stream_stats_lat_t lat, uint32_t us);
+
+/**
+ * @brief Read all counters and restart the peak frame size
+ *
+ * The counters are updated without locks from the capture and UVC tasks, the copy is
+ * not atomic as a whole but every single value is.
+ *
+ * @param out snapshot
+ */
+void stream_stats_snapshot(stream_stats_t *out);
+
+/**
+ * @brief Latency percentile between two snapshots
+ *
+ * @param cur newer snapshot
+ * @param prev older snapshot
+ * @param lat histogram to evaluate
+ * @param percent percentile, 1-100
+ * @return upper bound in microseconds of the bucket reaching the percentile, 0 without samples
+ */
+uint32_t stream_stats_percentile(const stream_stats_t *cur, const stream_stats_t *prev, stream_stats_lat_t lat, int percent);
+
+/**
+ * @brief Log the activity between two snapshots
+ *
+ * @param cur newer snapshot
+ * @param prev older snapshot
+ * @param elapsed_us time between the snapshots
+ * @param requested_fps frame rate negotiated by the host
+ */
+void stream_stats_report(const stream_stats_t *cur, const stream_stats_t *prev, int64_t elapsed_us, int requested_fps);
+
+#ifdef __cplusplus
+}
+#endif
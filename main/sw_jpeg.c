@@ -0,0 +1,206 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <assert.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "img_converters.h"
+#include "sw_jpeg.h"
+
+static const char *TAG = "sw_jpeg";
+
+#define SW_JPEG_BUF_COUNT       2
+#define SW_JPEG_TASK_STACK      (8 * 1024)
+#define SW_JPEG_TASK_PRIORITY   5
+// Encode on the core that does not run the USB stack
+#define SW_JPEG_TASK_CORE       (portNUM_PROCESSORS - 1)
+#define SW_JPEG_WAIT_MS         1000
+
+typedef struct {
+    camera_fb_t fb;
+    uint8_t *buf;
+} sw_jpeg_slot_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+} sw_jpeg_writer_t;
+
+static struct {
+    sw_jpeg_slot_t slots[SW_JPEG_BUF_COUNT];
+    size_t out_size;
+    QueueHandle_t free_q;
+    QueueHandle_t ready_q;
+    SemaphoreHandle_t stopped;
+    TaskHandle_t task;
+    volatile bool run;
+    volatile uint8_t quality;
+} s_enc;
+
+static uint8_t sensor_to_encoder_quality(int quality)
+{
+    // Sensor quality is a quantizer scale (0-63, lower is better), the encoder uses 1-100
+    int q = 100 - quality * 100 / 63;
+    return q < 1 ? 1 : (q > 100 ? 100 : q);
+}
+
+static size_t sw_jpeg_write_cb(void *arg, size_t index, const void *data, size_t len)
+{
+    sw_jpeg_writer_t *w = (sw_jpeg_writer_t *)arg;
+    if (index + len <= w->size) {
+        memcpy(w->buf + index, data, len);
+    }
+    // Keep counting past the end, so that the caller learns the real frame size
+    w->len = index + len;
+    return len;
+}
+
+static void sw_jpeg_task(void *arg)
+{
+    (void)arg;
+    int idx;
+
+    while (s_enc.run) {
+        if (xQueueReceive(s_enc.free_q, &idx, pdMS_TO_TICKS(100)) != pdTRUE) {
+            continue;
+        }
+        camera_fb_t *raw = esp_camera_fb_get();
+        if (!raw) {
+            xQueueSend(s_enc.free_q, &idx, 0);
+            continue;
+        }
+
+        sw_jpeg_slot_t *slot = &s_enc.slots[idx];
+        sw_jpeg_writer_t writer = {
+            .buf = slot->buf,
+            .size = s_enc.out_size,
+        };
+        bool ok = fmt2jpg_cb(raw->buf, raw->len, raw->width, raw->height, raw->format,
+                             s_enc.quality, sw_jpeg_write_cb, &writer);
+
+        slot->fb.len = writer.len;
+        slot->fb.width = raw->width;
+        slot->fb.height = raw->height;
+        slot->fb.timestamp = raw->timestamp;
+        esp_camera_fb_return(raw);
+
+        if (!ok) {
+            ESP_LOGE(TAG, "JPEG encoding failed");
+            xQueueSend(s_enc.free_q, &idx, 0);
+            continue;
+        }
+        xQueueSend(s_enc.ready_q, &idx, portMAX_DELAY);
+    }
+
+    xSemaphoreGive(s_enc.stopped);
+    vTaskDelete(NULL);
+}
+
+esp_err_t sw_jpeg_start(size_t out_size, int quality)
+{
+    if (s_enc.task) {
+        sw_jpeg_set_quality(quality);
+        return ESP_OK;
+    }
+
+    s_enc.out_size = out_size;
+    s_enc.quality = sensor_to_encoder_quality(quality);
+    s_enc.free_q = xQueueCreate(SW_JPEG_BUF_COUNT, sizeof(int));
+    s_enc.ready_q = xQueueCreate(SW_JPEG_BUF_COUNT, sizeof(int));
+    s_enc.stopped = xSemaphoreCreateBinary();
+    if (!s_enc.free_q || !s_enc.ready_q || !s_enc.stopped) {
+        goto fail;
+    }
+
+    for (int i = 0; i < SW_JPEG_BUF_COUNT; i++) {
+        sw_jpeg_slot_t *slot = &s_enc.slots[i];
+        slot->buf = heap_caps_malloc(out_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!slot->buf) {
+            goto fail;
+        }
+        memset(&slot->fb, 0, sizeof(slot->fb));
+        slot->fb.buf = slot->buf;
+        slot->fb.format = PIXFORMAT_JPEG;
+        xQueueSend(s_enc.free_q, &i, 0);
+    }
+
+    s_enc.run = true;
+    if (xTaskCreatePinnedToCore(sw_jpeg_task, "sw_jpeg", SW_JPEG_TASK_STACK, NULL,
+                                SW_JPEG_TASK_PRIORITY, &s_enc.task, SW_JPEG_TASK_CORE) != pdPASS) {
+        s_enc.task = NULL;
+        goto fail;
+    }
+    ESP_LOGI(TAG, "Software JPEG encoder started on core %d, %d x %zu bytes output",
+             SW_JPEG_TASK_CORE, SW_JPEG_BUF_COUNT, out_size);
+    return ESP_OK;
+
+fail:
+    ESP_LOGE(TAG, "Failed to start software JPEG encoder");
+    s_enc.run = false;
+    sw_jpeg_stop();
+    return ESP_ERR_NO_MEM;
+}
+
+void sw_jpeg_stop(void)
+{
+    if (s_enc.task) {
+        s_enc.run = false;
+        xSemaphoreTake(s_enc.stopped, portMAX_DELAY);
+        s_enc.task = NULL;
+    }
+    for (int i = 0; i < SW_JPEG_BUF_COUNT; i++) {
+        free(s_enc.slots[i].buf);
+        s_enc.slots[i].buf = NULL;
+    }
+    if (s_enc.free_q) {
+        vQueueDelete(s_enc.free_q);
+        s_enc.free_q = NULL;
+    }
+    if (s_enc.ready_q) {
+        vQueueDelete(s_enc.ready_q);
+        s_enc.ready_q = NULL;
+    }
+    if (s_enc.stopped) {
+        vSemaphoreDelete(s_enc.stopped);
+        s_enc.stopped = NULL;
+    }
+}
+
+bool sw_jpeg_is_running(void)
+{
+    return s_enc.task != NULL;
+}
+
+camera_fb_t *sw_jpeg_fb_get(void)
+{
+    int idx;
+    // Stopped, e.g. by a stream that switched to a raw format
+    if (!s_enc.ready_q) {
+        return NULL;
+    }
+    if (xQueueReceive(s_enc.ready_q, &idx, pdMS_TO_TICKS(SW_JPEG_WAIT_MS)) != pdTRUE) {
+        return NULL;
+    }
+    return &s_enc.slots[idx].fb;
+}
+
+void sw_jpeg_fb_return(camera_fb_t *fb)
+{
+    int idx = (sw_jpeg_slot_t *)fb - s_enc.slots;
+    assert(idx >= 0 && idx < SW_JPEG_BUF_COUNT);
+    xQueueSend(s_enc.free_q, &idx, 0);
+}
+
+void sw_jpeg_set_quality(int quality)
+{
+    s_enc.quality = sensor_to_encoder_quality(quality);
+}
@@ -0,0 +1,64 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "esp_camera.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Start the software JPEG encoder stage
+ *
+ * A task pinned to the last core pulls raw frames (YUV422 or RGB565) from the camera
+ * driver and encodes them into a small set of output buffers. The encoded frames are
+ * handed out as camera_fb_t so they can be consumed like frames of a JPEG sensor.
+ *
+ * @param out_size size of each output buffer, larger frames are reported but truncated
+ * @param quality initial quality in sensor units (0-63, lower is better)
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if buffers or the task cannot be created
+ */
+esp_err_t sw_jpeg_start(size_t out_size, int quality);
+
+/**
+ * @brief Stop the encoder task and free its buffers
+ *
+ * All frames returned by sw_jpeg_fb_get must have been given back.
+ */
+void sw_jpeg_stop(void);
+
+/**
+ * @brief Whether the encoder stage is running
+ */
+bool sw_jpeg_is_running(void);
+
+/**
+ * @brief Wait for the next encoded frame
+ *
+ * @return encoded frame, or NULL on timeout or while the encoder is stopped. The len
+ *         field holds the full encoded size, which exceeds out_size if the frame did
+ *         not fit
+ */
+camera_fb_t *sw_jpeg_fb_get(void);
+
+/**
+ * @brief Give an encoded frame back to the encoder
+ */
+void sw_jpeg_fb_return(camera_fb_t *fb);
+
+/**
+ * @brief Change the encoder quality
+ *
+ * @param quality quality in sensor units (0-63, lower is better)
+ */
+void sw_jpeg_set_quality(int quality);
+
+#ifdef __cplusplus
+}
+#endif
@@ -6,26 +6,86 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
 #include "esp_timer.h"
 #include "esp_log.h"
 #include "camera_pin.h"
 #include "esp_camera.h"
 #include "usb_device_uvc.h"
 #include "uvc_frame_config.h"
+#include "jpeg_rate_ctrl.h"
+#include "frame_pool.h"
+#include "frame_ring.h"
+#include "stream_stats.h"
+#include "uvc_telemetry.h"
+#include "sensor_ctrl.h"
+#if CONFIG_CAMERA_STORE
+#include "camera_store.h"
+#endif
+#include "yuv_convert.h"
+#if CONFIG_CAMERA_SW_JPEG
+#include "sw_jpeg.h"
+#endif
+#if CONFIG_CAMERA_LCD_PREVIEW
+#include "lcd_preview.h"
+#endif
+#if CONFIG_CAMERA_LCD_EYES
+#include "tusb.h"
+#include "eyes_ctrl.h"
+#endif
 
 static const char *TAG = "usb_webcam";
 
 #define CAMERA_XCLK_FREQ           CONFIG_CAMERA_XCLK_FREQ
-#define CAMERA_FB_COUNT            2
+#define CAMERA_FB_COUNT            CONFIG_CAMERA_FB_COUNT
+
+#if CONFIG_CAMERA_PROFILE_LOW_LATENCY
+#define CAMERA_GRAB_MODE           CAMERA_GRAB_LATEST
+#else
+#define CAMERA_GRAB_MODE           CAMERA_GRAB_WHEN_EMPTY
+#endif
+
+#if CONFIG_CAMERA_SW_JPEG_INPUT_RGB565
+#define CAMERA_SW_JPEG_INPUT       PIXFORMAT_RGB565
+#else
+#define CAMERA_SW_JPEG_INPUT       PIXFORMAT_YUV422
+#endif
 
-#if CONFIG_IDF_TARGET_ESP32S3
-#define UVC_MAX_FRAMESIZE_SIZE     (75*1024)
+#if CONFIG_FREERTOS_UNICORE
+#define CAPTURE_TASK_CORE          0
 #else
-#define UVC_MAX_FRAMESIZE_SIZE     (60*1024)
+#define CAPTURE_TASK_CORE          CONFIG_CAMERA_CAPTURE_TASK_CORE
 #endif
+#define CAPTURE_TASK_PRIORITY      CONFIG_CAMERA_CAPTURE_TASK_PRIORITY
+#define CAPTURE_TASK_STACK         4096
+// Frames the capture task may queue ahead, one driver buffer is left to the sensor
+#define CAPTURE_QUEUE_DEPTH        (CAMERA_FB_COUNT > 1 ? CAMERA_FB_COUNT - 1 : 1)
+// Longest the capture task sleeps while all slots are in flight
+#define CAPTURE_WAIT_MS            10
+
+_Static_assert(CAPTURE_QUEUE_DEPTH <= FRAME_RING_SIZE, "frame ring too small for CAMERA_FB_COUNT");
+#if CONFIG_CAMERA_LCD_PREVIEW
+_Static_assert(CAMERA_FB_COUNT >= 2, "the LCD preview needs a spare frame buffer");
+#endif
+
+#if CONFIG_CAMERA_WARMUP
+#define CAMERA_INIT_POLICY         "warmed up at boot"
+#define CAMERA_WARMUP_TASK_STACK   4096
+#else
+#define CAMERA_INIT_POLICY         "initialized on stream start"
+#endif
+
+// Interval of the streaming statistics report
+#define STATS_REPORT_INTERVAL_US   5000000
+
+#define UVC_BUFFER_INTERNAL_MAX    (CONFIG_UVC_BUFFER_INTERNAL_MAX * 1024)
+#define UVC_BUFFER_INTERNAL_RESERVE (CONFIG_UVC_BUFFER_INTERNAL_RESERVE * 1024)
+#define UVC_BUFFER_INTERNAL_CAPS   (MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA | MALLOC_CAP_8BIT)
 
 // Format name mapping for logging
 static const char *uvc_format_names[] = {
@@ -39,9 +99,33 @@ static const char *uvc_format_names[] = {
 typedef struct {
     camera_fb_t *cam_fb_p;
     uvc_fb_t uvc_fb;
+    uint8_t *conv_buf;  // Output of formats that cannot be converted in place
+    int64_t sent_us;    // Time the frame was handed to UVC
 } fb_t;
 
-static fb_t s_fb;
+// One slot per camera frame buffer, so every buffer the driver owns can be lent to UVC at once
+static fb_t s_fb[CAMERA_FB_COUNT];
+static frame_pool_t s_fb_pool;
+
+// Frames ready for UVC, the capture task is the only producer. The consumer is fb_get_cb on the
+// video task, or camera_capture_pause() on the TinyUSB task, whoever holds s_capture.consumer.
+static frame_ring_t s_frame_ring;
+
+static struct {
+    TaskHandle_t task;
+    SemaphoreHandle_t ready;    // Given after a frame was queued
+    SemaphoreHandle_t space;    // Given after a slot was taken from the ring or returned
+    SemaphoreHandle_t idle;     // Given by the task each time it parks
+    SemaphoreHandle_t consumer; // Held while frames are taken from the ring
+    volatile bool run;
+} s_capture;
+
+// Mode negotiated by the host, the driver buffers are allocated for the largest enabled
+// mode so that smaller modes can be selected through the sensor without reallocating them
+static const uvc_mode_t *s_mode = &UVC_MODES[0];
+
+// Configured once before uvc_device_init, the transfer buffer fits every enabled mode
+static uvc_device_config_t s_uvc_config;
 
 // Current negotiated UVC parameters
 static struct {
@@ -58,12 +142,48 @@ static struct {
     .frame_interval = 333333
 };
 
-static esp_err_t camera_init(uint32_t xclk_freq_hz, pixformat_t pixel_format, framesize_t frame_size, int jpeg_quality, uint8_t fb_count)
+#if CONFIG_CAMERA_JPEG_RATE_CTRL
+static jpeg_rate_ctrl_t s_rate_ctrl;
+#endif
+
+// Frames still queued in the driver from before a sensor reconfiguration
+static volatile int s_stale_frames;
+
+// Set while the camera runs without a stream, the driver keeps the frames it queued then
+static bool s_camera_idle;
+
+#if CONFIG_CAMERA_STANDBY
+static bool s_camera_standby;
+#endif
+
+#if CONFIG_CAMERA_WARMUP
+// Given once the boot warm-up finished, and given back by every callback that waited for it
+static SemaphoreHandle_t s_warmup_done;
+static volatile bool s_warmup_finished;
+#endif
+
+// Start of the current stream, for the time-to-first-frame report
+static int64_t s_stream_start_us;
+static bool s_first_frame_pending;
+
+#if CONFIG_CAMERA_FRAME_RATE_PACING
+// Earliest time the next frame may be handed to UVC
+static int64_t s_next_frame_us;
+#endif
+
+#if CONFIG_CAMERA_SW_JPEG
+// Set once the sensor turned out to have no JPEG encoder
+static bool s_sw_jpeg;
+#endif
+
+static esp_err_t camera_init(uint32_t xclk_freq_hz, pixformat_t pixel_format, framesize_t frame_size, framesize_t max_frame_size,
+                             int jpeg_quality, uint8_t fb_count)
 {
     static bool inited = false;
     static uint32_t cur_xclk_freq_hz = 0;
     static pixformat_t cur_pixel_format = 0;
     static framesize_t cur_frame_size = 0;
+    static framesize_t cur_max_frame_size = 0;
     static int cur_jpeg_quality = 0;
     static uint8_t cur_fb_count = 0;
 
@@ -71,7 +191,28 @@ static esp_err_t camera_init(uint32_t xclk_freq_hz, pixformat_t pixel_format, fr
             && cur_frame_size == frame_size && cur_fb_count == fb_count && cur_jpeg_quality == jpeg_quality)) {
         ESP_LOGD(TAG, "camera already inited");
         return ESP_OK;
-    } else if (inited) {
+    }
+
+    int64_t switch_start_us = esp_timer_get_time();
+    // The driver sizes its buffers and the expected frame length at init and drops raw frames of
+    // any other length, only JPEG frames may shrink below the size it was initialized with
+    bool jpeg = pixel_format == PIXFORMAT_JPEG;
+    if (jpeg && inited && cur_xclk_freq_hz == xclk_freq_hz && cur_pixel_format == pixel_format
+            && cur_fb_count == fb_count && cur_max_frame_size == max_frame_size && frame_size <= max_frame_size) {
+        // Only size or quality changed, the buffers already fit the largest mode
+        sensor_t *s = esp_camera_sensor_get();
+        if (frame_size == cur_frame_size || s->set_framesize(s, frame_size) == 0) {
+            s->set_quality(s, jpeg_quality);
+            s_stale_frames = fb_count;
+            cur_frame_size = frame_size;
+            cur_jpeg_quality = jpeg_quality;
+            ESP_LOGI(TAG, "camera reconfigured in %"PRId64" us", esp_timer_get_time() - switch_start_us);
+            return ESP_OK;
+        }
+        ESP_LOGW(TAG, "set_framesize failed, restarting camera");
+    }
+
+    if (inited) {
         esp_camera_return_all();
         esp_camera_deinit();
         inited = false;
@@ -102,11 +243,11 @@ static esp_err_t camera_init(uint32_t xclk_freq_hz, pixformat_t pixel_format, fr
         .ledc_channel = LEDC_CHANNEL_0,
 
         .pixel_format = pixel_format,
-        .frame_size = frame_size,
+        .frame_size = jpeg && max_frame_size > frame_size ? max_frame_size : frame_size,
 
         .jpeg_quality = jpeg_quality,
         .fb_count = fb_count,
-        .grab_mode = CAMERA_GRAB_WHEN_EMPTY,
+        .grab_mode = CAMERA_GRAB_MODE,
         .fb_location = CAMERA_FB_IN_PSRAM
     };
 
@@ -117,9 +258,13 @@ static esp_err_t camera_init(uint32_t xclk_freq_hz, pixformat_t pixel_format, fr
     }
 
     // Get the sensor object, and then use some of its functions to adjust the parameters when taking a photo.
-    // Note: Do not call functions that set resolution, set picture format and PLL clock,
-    // If you need to reset the appeal parameters, please reinitialize the sensor.
+    // Note: Do not call functions that set picture format and PLL clock, if you need to reset the appeal
+    // parameters, please reinitialize the sensor. A JPEG resolution may only shrink below the one the
+    // driver was initialized with, since the frame buffers are sized for it.
     sensor_t *s = esp_camera_sensor_get();
+    if (frame_size < camera_config.frame_size) {
+        s->set_framesize(s, frame_size);
+    }
     s->set_vflip(s, 1); // flip it back
     
     // initial sensors are flipped vertically and colors are a bit saturated
@@ -140,162 +285,802 @@ static esp_err_t camera_init(uint32_t xclk_freq_hz, pixformat_t pixel_format, fr
     camera_sensor_info_t *s_info = esp_camera_sensor_get_info(&(s->id));
     ESP_LOGI(TAG, "Camera sensor: %s (PID: 0x%x)", s_info->name, s->id.PID);
 
-    if (ESP_OK == ret && PIXFORMAT_JPEG == pixel_format && s_info->support_jpeg == true) {
+    if (ESP_OK == ret && (PIXFORMAT_JPEG != pixel_format || s_info->support_jpeg == true)) {
         cur_xclk_freq_hz = xclk_freq_hz;
         cur_pixel_format = pixel_format;
         cur_frame_size = frame_size;
+        cur_max_frame_size = max_frame_size;
         cur_jpeg_quality = jpeg_quality;
         cur_fb_count = fb_count;
         inited = true;
+        s_stale_frames = 0;
+        s_camera_idle = false;
+        // Image controls survive the restart, they are written again before the next frame
+        sensor_ctrl_attach(s);
+        ESP_LOGI(TAG, "camera initialized in %"PRId64" us", esp_timer_get_time() - switch_start_us);
     } else {
         ESP_LOGE(TAG, "JPEG format is not supported");
+        esp_camera_deinit();
         return ESP_ERR_NOT_SUPPORTED;
     }
 
     return ret;
 }
 
+// The encoder runs for MJPEG streams of a sensor without JPEG only, s_sw_jpeg stays set
+// for the raw streams that may follow
+static camera_fb_t *camera_frame_get(void)
+{
+#if CONFIG_CAMERA_SW_JPEG
+    if (sw_jpeg_is_running()) {
+        return sw_jpeg_fb_get();
+    }
+#endif
+    return esp_camera_fb_get();
+}
+
+static void camera_frame_return(camera_fb_t *fb)
+{
+#if CONFIG_CAMERA_SW_JPEG
+    if (sw_jpeg_is_running()) {
+        sw_jpeg_fb_return(fb);
+        return;
+    }
+#endif
+    esp_camera_fb_return(fb);
+}
+
+static void camera_set_quality(int quality)
+{
+#if CONFIG_CAMERA_SW_JPEG
+    if (sw_jpeg_is_running()) {
+        sw_jpeg_set_quality(quality);
+        return;
+    }
+#endif
+    sensor_t *s = esp_camera_sensor_get();
+    s->set_quality(s, quality);
+}
+
+static void camera_slot_release(fb_t *fb)
+{
+    camera_frame_return(fb->cam_fb_p);
+    frame_pool_release(&s_fb_pool, fb - s_fb);
+    xSemaphoreGive(s_capture.space);
+}
+
+static void camera_capture_pause(void)
+{
+    if (!s_capture.run) {
+        return;
+    }
+    s_capture.run = false;
+    // Wake the task if it waits for a slot, it parks before it touches the driver again
+    xSemaphoreGive(s_capture.space);
+    xSemaphoreTake(s_capture.idle, portMAX_DELAY);
+
+    // Hand the queued frames back to the driver, with fb_get_cb parked so that the ring keeps a
+    // single consumer. Nothing is queued again until the task resumes.
+    xSemaphoreTake(s_capture.consumer, portMAX_DELAY);
+    fb_t *fb;
+    while ((fb = frame_ring_pop(&s_frame_ring)) != NULL) {
+        camera_slot_release(fb);
+    }
+    xSemaphoreGive(s_capture.consumer);
+#if CONFIG_CAMERA_LCD_PREVIEW
+    // The driver may be restarted next, the preview must not keep one of its buffers
+    lcd_preview_stop();
+#endif
+}
+
+static void camera_capture_resume(void)
+{
+    if (s_capture.run) {
+        return;
+    }
+#if !CONFIG_CAMERA_PROFILE_LOW_LATENCY
+    // Frames the driver queued while nobody streamed are old by now
+    if (s_camera_idle && s_stale_frames == 0) {
+        s_stale_frames = CAMERA_FB_COUNT;
+    }
+#endif
+    s_camera_idle = false;
+    s_capture.run = true;
+    xTaskNotifyGive(s_capture.task);
+}
+
+#if CONFIG_CAMERA_STANDBY
+static void camera_standby(bool standby)
+{
+    sensor_t *s = esp_camera_sensor_get();
+    if (!s || s_camera_standby == standby) {
+        return;
+    }
+#if CONFIG_CAMERA_SW_JPEG
+    if (standby) {
+        // The encoder would keep waiting for frames that do not come
+        sw_jpeg_stop();
+    }
+#endif
+    if (sensor_ctrl_standby(s, standby) == ESP_OK) {
+        s_camera_standby = standby;
+        ESP_LOGI(TAG, "Sensor %s", standby ? "in standby" : "awake");
+    }
+}
+#endif
+
+static void camera_warmup_wait(void)
+{
+#if CONFIG_CAMERA_WARMUP
+    // start_cb and stop_cb come from the TinyUSB task, but nothing here relies on it: the
+    // semaphore is given back for any other waiter and never deleted
+    if (s_warmup_done && !s_warmup_finished) {
+        xSemaphoreTake(s_warmup_done, portMAX_DELAY);
+        xSemaphoreGive(s_warmup_done);
+        s_warmup_finished = true;
+    }
+#endif
+}
+
 static void camera_stop_cb(void *cb_ctx)
 {
     (void)cb_ctx;
     ESP_LOGI(TAG, "Camera Stop");
+#if CONFIG_CAMERA_LCD_EYES
+    eyes_ctrl_post(EYES_EVENT_STREAM_STOP);
+#endif
+    camera_warmup_wait();
+    camera_capture_pause();
+    s_camera_idle = true;
+#if CONFIG_CAMERA_STORE
+    // The auto controls had the whole stream to converge, keep their result for the next boot
+    sensor_t *s = esp_camera_sensor_get();
+    if (s) {
+        camera_store_save_tuning(s);
+    }
+#endif
+#if CONFIG_CAMERA_SW_JPEG
+    sw_jpeg_stop();
+#endif
+#if CONFIG_CAMERA_STANDBY
+    camera_standby(true);
+#endif
+}
+
+static esp_err_t camera_conv_bufs_alloc(void)
+{
+    // Allocated once for the largest NV12 frame and kept, modes are switched often
+    for (int i = 0; i < CAMERA_FB_COUNT; i++) {
+        if (s_fb[i].conv_buf) {
+            continue;
+        }
+        s_fb[i].conv_buf = heap_caps_malloc(UVC_MAX_NV12_FRAME_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!s_fb[i].conv_buf) {
+            ESP_LOGE(TAG, "malloc conversion buffer fail");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+#if CONFIG_UVC_MODE_MJPEG_ROI
+_Static_assert(CONFIG_UVC_ROI_X + CONFIG_UVC_ROI_WINDOW_WIDTH <= 1600 && CONFIG_UVC_ROI_Y + CONFIG_UVC_ROI_WINDOW_HEIGHT <= 1200,
+               "Region of interest exceeds the sensor");
+_Static_assert(CONFIG_UVC_ROI_WIDTH <= CONFIG_UVC_ROI_WINDOW_WIDTH && CONFIG_UVC_ROI_HEIGHT <= CONFIG_UVC_ROI_WINDOW_HEIGHT,
+               "The sensor can only scale the region of interest down");
+_Static_assert(CONFIG_UVC_ROI_X % 4 == 0 && CONFIG_UVC_ROI_Y % 4 == 0 && CONFIG_UVC_ROI_WINDOW_WIDTH % 4 == 0
+               && CONFIG_UVC_ROI_WINDOW_HEIGHT % 4 == 0 && CONFIG_UVC_ROI_WIDTH % 4 == 0 && CONFIG_UVC_ROI_HEIGHT % 4 == 0,
+               "Region of interest must be aligned to 4 pixels");
+
+static esp_err_t camera_roi_apply(void)
+{
+    sensor_t *s = esp_camera_sensor_get();
+    if (s->id.PID != OV2640_PID) {
+        ESP_LOGE(TAG, "Region of interest needs an OV2640, sensor PID is 0x%x", s->id.PID);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    // On the OV2640 startX selects the readout (0 is UXGA), the DSP then crops the
+    // offset/total window and scales it to the output size
+    if (s->set_res_raw(s, 0, 0, 0, 0, CONFIG_UVC_ROI_X, CONFIG_UVC_ROI_Y, CONFIG_UVC_ROI_WINDOW_WIDTH, CONFIG_UVC_ROI_WINDOW_HEIGHT,
+                       CONFIG_UVC_ROI_WIDTH, CONFIG_UVC_ROI_HEIGHT, true, false) != 0) {
+        ESP_LOGE(TAG, "set_res_raw failed");
+        return ESP_FAIL;
+    }
+    s_stale_frames = CAMERA_FB_COUNT;
+    ESP_LOGI(TAG, "Region of interest %dx%d at (%d, %d), output %dx%d", CONFIG_UVC_ROI_WINDOW_WIDTH, CONFIG_UVC_ROI_WINDOW_HEIGHT,
+             CONFIG_UVC_ROI_X, CONFIG_UVC_ROI_Y, CONFIG_UVC_ROI_WIDTH, CONFIG_UVC_ROI_HEIGHT);
+    return ESP_OK;
+}
+#endif
+
+static esp_err_t camera_start_raw(framesize_t frame_size)
+{
+    ESP_LOGI(TAG, "Initializing camera with YUV422 format, %dx%d resolution", s_uvc_params.width, s_uvc_params.height);
+#if CONFIG_CAMERA_SW_JPEG
+    sw_jpeg_stop();
+#endif
+    // Raw frames are sent as captured, the quality argument is unused. The driver starts at the exact
+    // mode size, another raw size restarts it.
+    esp_err_t ret = camera_init(CAMERA_XCLK_FREQ, PIXFORMAT_YUV422, frame_size, frame_size, 0, CAMERA_FB_COUNT);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Camera init failed: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+// Allocated once before uvc_device_init, the component and TinyUSB keep the pointer
+static esp_err_t uvc_buffer_alloc(void)
+{
+    size_t size = UVC_MAX_FRAME_BYTES;
+    // The component copies each frame out of the camera buffer into this one and USB reads it from
+    // there. In internal RAM the frame crosses PSRAM once instead of three times, leaving the PSRAM
+    // bandwidth to the camera DMA.
+    const char *heap = "internal RAM";
+    uint8_t *buf = NULL;
+    size_t internal_free = heap_caps_get_free_size(UVC_BUFFER_INTERNAL_CAPS);
+    if (size <= UVC_BUFFER_INTERNAL_MAX && internal_free >= size + UVC_BUFFER_INTERNAL_RESERVE) {
+        buf = heap_caps_malloc(size, UVC_BUFFER_INTERNAL_CAPS);
+    }
+    if (!buf) {
+        ESP_LOGW(TAG, "UVC buffer not in internal RAM: %u bytes, limit %u, %u free with %u to keep", (unsigned)size,
+                 (unsigned)UVC_BUFFER_INTERNAL_MAX, (unsigned)internal_free, (unsigned)UVC_BUFFER_INTERNAL_RESERVE);
+        heap = "PSRAM";
+        buf = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+    if (!buf) {
+        ESP_LOGE(TAG, "malloc frame buffer fail");
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_uvc_config.uvc_buffer = buf;
+    s_uvc_config.uvc_buffer_size = size;
+    ESP_LOGI(TAG, "UVC buffer %u bytes in %s, sized for the largest negotiable mode", (unsigned)size, heap);
+    return ESP_OK;
+}
+
+static esp_err_t camera_start_mjpeg(int mode_id)
+{
+    framesize_t frame_size = s_mode->frame_size;
+    int jpeg_quality = s_mode->jpeg_quality;
+
+    ESP_LOGI(TAG, "Initializing camera with MJPEG format, %dx%d resolution, quality %d", s_mode->frame.width, s_mode->frame.height, jpeg_quality);
+
+    pixformat_t pixel_format = PIXFORMAT_JPEG;
+#if CONFIG_CAMERA_SW_JPEG
+    // The encoder pulls frames from the driver, stop it before the driver may be restarted
+    sw_jpeg_stop();
+    if (s_sw_jpeg) {
+        pixel_format = CAMERA_SW_JPEG_INPUT;
+    }
+#endif
+    esp_err_t ret = camera_init(CAMERA_XCLK_FREQ, pixel_format, frame_size, UVC_MAX_MJPEG_FRAME_SIZE, jpeg_quality, CAMERA_FB_COUNT);
+#if CONFIG_CAMERA_SW_JPEG
+    if (ret == ESP_ERR_NOT_SUPPORTED && pixel_format == PIXFORMAT_JPEG) {
+        ESP_LOGW(TAG, "Sensor has no JPEG encoder, encoding in software");
+        s_sw_jpeg = true;
+        ret = camera_init(CAMERA_XCLK_FREQ, CAMERA_SW_JPEG_INPUT, frame_size, UVC_MAX_MJPEG_FRAME_SIZE, jpeg_quality, CAMERA_FB_COUNT);
+    }
+    if (ret == ESP_OK && s_sw_jpeg) {
+        ret = sw_jpeg_start(s_mode->max_frame_bytes, jpeg_quality);
+    }
+#endif
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Camera init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+#if CONFIG_UVC_MODE_MJPEG_ROI
+    if (mode_id == UVC_MODE_ROI) {
+        ret = camera_roi_apply();
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+#endif
+
+#if CONFIG_CAMERA_JPEG_RATE_CTRL
+    // The sensor may still run with a quality degraded by the previous stream
+    camera_set_quality(jpeg_quality);
+    jpeg_rate_ctrl_init(&s_rate_ctrl, s_mode->max_frame_bytes, CONFIG_CAMERA_JPEG_RATE_CTRL_BUDGET,
+                        jpeg_quality, CONFIG_CAMERA_JPEG_RATE_CTRL_WORST_QUALITY);
+#endif
+
+    return ESP_OK;
+}
+
+// Bring the camera up in a mode, the capture task must be paused
+static esp_err_t camera_mode_start(int mode_id)
+{
+    s_mode = &UVC_MODES[mode_id];
+    uvc_format_t format = s_mode->format;
+    framesize_t frame_size = s_mode->frame_size;
+
+    esp_err_t ret;
+    if (format == UVC_FORMAT_NV12) {
+        // Converted into a per-slot buffer before the frame is sent
+        ret = camera_conv_bufs_alloc();
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    if (format != UVC_FORMAT_MJPEG) {
+        // YUY2 is sent as captured, GRAY8 and NV12 are converted from YUV422
+        ret = camera_start_raw(frame_size);
+    } else {
+        ret = camera_start_mjpeg(mode_id);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+#if CONFIG_CAMERA_STORE
+    static bool tuning_restored = false;
+    if (!tuning_restored) {
+        camera_store_restore(esp_camera_sensor_get());
+        tuning_restored = true;
+    }
+#endif
+    return ESP_OK;
+}
+
+static void camera_uvc_params_set(uvc_format_t format, int width, int height, int rate)
+{
+    s_uvc_params.format = format;
+    s_uvc_params.width = width;
+    s_uvc_params.height = height;
+    s_uvc_params.frame_rate = rate;
+    s_uvc_params.frame_interval = 10000000 / rate;
+#if CONFIG_CAMERA_FRAME_RATE_PACING
+    s_next_frame_us = 0;
+#endif
 }
 
 static esp_err_t camera_start_cb(uvc_format_t format, int width, int height, int rate, void *cb_ctx)
 {
     (void)cb_ctx;
     ESP_LOGI(TAG, "========== UVC Negotiation Parameters ==========");
-    ESP_LOGI(TAG, "Format: %s (%d)", format < sizeof(uvc_format_names)/sizeof(uvc_format_names[0]) ? 
-                                      uvc_format_names[format] : "UNKNOWN", format);
+    if (format >= sizeof(uvc_format_names) / sizeof(uvc_format_names[0])) {
+        format = 0;
+    }
+    ESP_LOGI(TAG, "Format: %s (%d)", uvc_format_names[format], format);
     ESP_LOGI(TAG, "Resolution: %dx%d", width, height);
     ESP_LOGI(TAG, "Frame Rate: %d fps", rate);
     ESP_LOGI(TAG, "Frame Interval: %d (100ns units)", 10000000 / rate);
     ESP_LOGI(TAG, "================================================");
-    
+    s_stream_start_us = esp_timer_get_time();
+    s_first_frame_pending = true;
+
+    camera_warmup_wait();
+    // The driver may be restarted below, the capture task must not be waiting on it
+    camera_capture_pause();
+#if CONFIG_CAMERA_STANDBY
+    camera_standby(false);
+#endif
     // Store the negotiated parameters
-    s_uvc_params.format = format;
-    s_uvc_params.width = width;
-    s_uvc_params.height = height;
-    s_uvc_params.frame_rate = rate;
-    s_uvc_params.frame_interval = 10000000 / rate;
-    
-    framesize_t frame_size = FRAMESIZE_QVGA;
-    int jpeg_quality = 14;
+    camera_uvc_params_set(format, width, height, rate);
 
-    if (format != UVC_FORMAT_MJPEG) {
-        ESP_LOGE(TAG, "Only support MJPEG format");
+    int mode_id = uvc_mode_find(format, width, height);
+    if (mode_id < 0) {
+        ESP_LOGE(TAG, "Unsupported mode %s %dx%d", uvc_format_names[format], width, height);
         return ESP_ERR_NOT_SUPPORTED;
     }
+    esp_err_t ret = camera_mode_start(mode_id);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+#if CONFIG_CAMERA_STORE
+    camera_store_save_mode(UVC_MODE_KEY(format, width, height));
+#endif
+    camera_capture_resume();
+#if CONFIG_CAMERA_LCD_EYES
+    eyes_ctrl_post(EYES_EVENT_STREAM_START);
+#endif
+    return ESP_OK;
+}
 
-    // Map resolution to camera frame size
-    if (width == 320 && height == 240) {
-        frame_size = FRAMESIZE_QVGA;
-        jpeg_quality = 10;
-    } else if (width == 480 && height == 320) {
-        frame_size = FRAMESIZE_HVGA;
-        jpeg_quality = 10;
-    } else if (width == 640 && height == 480) {
-        frame_size = FRAMESIZE_VGA;
-        jpeg_quality = 12;
-    } else if (width == 800 && height == 600) {
-        frame_size = FRAMESIZE_SVGA;
-        jpeg_quality = 14;
-    } else if (width == 1280 && height == 720) {
-        frame_size = FRAMESIZE_HD;
-        jpeg_quality = 16;
-    } else if (width == 1920 && height == 1080) {
-        frame_size = FRAMESIZE_FHD;
-        jpeg_quality = 16;
-    } else {
-        ESP_LOGE(TAG, "Unsupported frame size %dx%d", width, height);
-        return ESP_ERR_NOT_SUPPORTED;
+#if CONFIG_CAMERA_FRAME_RATE_PACING
+static void camera_frame_pace(void)
+{
+    int64_t interval_us = s_uvc_params.frame_interval / 10;
+    int64_t now_us = esp_timer_get_time();
+
+    if (s_next_frame_us > now_us) {
+        vTaskDelay(pdMS_TO_TICKS((s_next_frame_us - now_us + 999) / 1000));
+        now_us = esp_timer_get_time();
     }
+    // Keep the long term rate, but do not build up credit while USB or the sensor are slow
+    if (s_next_frame_us < now_us - interval_us) {
+        s_next_frame_us = now_us;
+    }
+    s_next_frame_us += interval_us;
+}
+#endif
 
-    ESP_LOGI(TAG, "Initializing camera with %s format, %dx%d resolution, quality %d", 
-             format == UVC_FORMAT_MJPEG ? "MJPEG" : "OTHER", width, height, jpeg_quality);
-             
-    esp_err_t ret = camera_init(CAMERA_XCLK_FREQ, PIXFORMAT_JPEG, frame_size, jpeg_quality, CAMERA_FB_COUNT);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Camera init failed: %s", esp_err_to_name(ret));
-        return ret;
+#if CONFIG_CAMERA_JPEG_RATE_CTRL
+static void camera_rate_ctrl_feed(size_t frame_len)
+{
+    int prev_quality = s_rate_ctrl.quality;
+    int quality = jpeg_rate_ctrl_update(&s_rate_ctrl, frame_len);
+    if (quality != prev_quality) {
+        camera_set_quality(quality);
+        ESP_LOGD(TAG, "JPEG quality %d -> %d (frame %zu, avg %"PRIu32")", prev_quality, quality, frame_len, s_rate_ctrl.avg_len);
+    }
+}
+#endif
+
+// Grab, convert and check one frame, runs on the capture task
+static fb_t *camera_capture_frame(void)
+{
+    if (frame_ring_count(&s_frame_ring) >= CAPTURE_QUEUE_DEPTH) {
+        xSemaphoreTake(s_capture.space, pdMS_TO_TICKS(CAPTURE_WAIT_MS));
+        return NULL;
+    }
+    int slot = frame_pool_acquire(&s_fb_pool);
+    if (slot < 0) {
+        // All slots are queued or held by UVC, wait for one to come back
+        xSemaphoreTake(s_capture.space, pdMS_TO_TICKS(CAPTURE_WAIT_MS));
+        return NULL;
+    }
+    fb_t *fb = &s_fb[slot];
+
+#if CONFIG_CAMERA_FRAME_RATE_PACING
+    camera_frame_pace();
+#endif
+
+    // Drop frames captured with the previous sensor settings
+    while (s_stale_frames > 0) {
+        camera_fb_t *stale = camera_frame_get();
+        if (stale) {
+            camera_frame_return(stale);
+        }
+        s_stale_frames--;
+    }
+
+    // Between two frames, so a batch of control changes takes effect at once
+    sensor_ctrl_apply(esp_camera_sensor_get());
+
+    fb->cam_fb_p = camera_frame_get();
+    if (!fb->cam_fb_p) {
+        frame_pool_release(&s_fb_pool, slot);
+        return NULL;
+    }
+    stream_stats_captured();
+    fb->uvc_fb.buf = fb->cam_fb_p->buf;
+    fb->uvc_fb.len = fb->cam_fb_p->len;
+    // The driver reports the frame size it was set to, which is not the output of a window
+    fb->uvc_fb.width = s_uvc_params.width;
+    fb->uvc_fb.height = s_uvc_params.height;
+    fb->uvc_fb.format = s_uvc_params.format;
+    fb->uvc_fb.timestamp = fb->cam_fb_p->timestamp;
+
+    if (s_uvc_params.format == UVC_FORMAT_GRAY8) {
+        // In place, the driver buffer is overwritten by the next capture anyway. Sized from the
+        // negotiated mode, never from what the driver reports.
+        size_t pixels = (size_t)s_uvc_params.width * s_uvc_params.height;
+        yuv422_to_gray8(fb->cam_fb_p->buf, fb->cam_fb_p->buf, pixels);
+        fb->uvc_fb.len = pixels;
+    } else if (s_uvc_params.format == UVC_FORMAT_NV12) {
+        yuv422_to_nv12(fb->cam_fb_p->buf, fb->conv_buf, s_uvc_params.width, s_uvc_params.height);
+        fb->uvc_fb.buf = fb->conv_buf;
+        fb->uvc_fb.len = (size_t)s_uvc_params.width * s_uvc_params.height * 3 / 2;
+    }
+
+#if CONFIG_CAMERA_JPEG_RATE_CTRL
+    if (s_uvc_params.format == UVC_FORMAT_MJPEG) {
+        camera_rate_ctrl_feed(fb->uvc_fb.len);
+    }
+#endif
+
+    // Only compressed frames vary in size, raw frames always fit
+    size_t max_len = s_mode->max_frame_bytes;
+
+    if (fb->uvc_fb.len > max_len) {
+        ESP_LOGE(TAG, "Frame size %zu is larger than max frame size %zu", fb->uvc_fb.len, max_len);
+        stream_stats_dropped(STREAM_STATS_DROP_OVERSIZE);
+        camera_frame_return(fb->cam_fb_p);
+        frame_pool_release(&s_fb_pool, slot);
+        return NULL;
     }
+    return fb;
+}
 
+static void camera_capture_task(void *arg)
+{
+    (void)arg;
+    while (1) {
+        if (!s_capture.run) {
+            xSemaphoreGive(s_capture.idle);
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        fb_t *fb = camera_capture_frame();
+        if (fb) {
+            // Cannot fail, the queue depth is checked before a slot is taken
+            frame_ring_push(&s_frame_ring, fb);
+            xSemaphoreGive(s_capture.ready);
+        }
+    }
+}
+
+static esp_err_t camera_capture_init(void)
+{
+    frame_ring_init(&s_frame_ring);
+    s_capture.ready = xSemaphoreCreateBinary();
+    s_capture.space = xSemaphoreCreateBinary();
+    s_capture.idle = xSemaphoreCreateBinary();
+    s_capture.consumer = xSemaphoreCreateMutex();
+    if (!s_capture.ready || !s_capture.space || !s_capture.idle || !s_capture.consumer) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreatePinnedToCore(camera_capture_task, "capture", CAPTURE_TASK_STACK, NULL,
+                                CAPTURE_TASK_PRIORITY, &s_capture.task, CAPTURE_TASK_CORE) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    // The task starts paused, wait until it parked so that pause and resume stay paired
+    xSemaphoreTake(s_capture.idle, portMAX_DELAY);
     return ESP_OK;
 }
 
+static void camera_first_frame_log(int64_t now_us)
+{
+    static bool booted = false;
+    s_first_frame_pending = false;
+    ESP_LOGI(TAG, "First frame %"PRId64" us after stream start", now_us - s_stream_start_us);
+    if (!booted) {
+        booted = true;
+        ESP_LOGI(TAG, "First frame %"PRId64" us after boot, camera %s", now_us,
+                 CAMERA_INIT_POLICY);
+    }
+}
+
 static uvc_fb_t* camera_fb_get_cb(void *cb_ctx)
 {
     (void)cb_ctx;
-    s_fb.cam_fb_p = esp_camera_fb_get();
-    if (!s_fb.cam_fb_p) {
-        return NULL;
+    int64_t start_us = esp_timer_get_time();
+    xSemaphoreTake(s_capture.consumer, portMAX_DELAY);
+    fb_t *fb = frame_ring_pop(&s_frame_ring);
+    if (!fb) {
+        // Wait for the capture task at most one frame interval, never for the sensor itself, and
+        // leave the ring to camera_capture_pause() meanwhile
+        xSemaphoreGive(s_capture.consumer);
+        xSemaphoreTake(s_capture.ready, pdMS_TO_TICKS(s_uvc_params.frame_interval / 10000) + 1);
+        xSemaphoreTake(s_capture.consumer, portMAX_DELAY);
+        fb = frame_ring_pop(&s_frame_ring);
+        if (!fb) {
+            xSemaphoreGive(s_capture.consumer);
+            stream_stats_empty();
+            return NULL;
+        }
     }
-    s_fb.uvc_fb.buf = s_fb.cam_fb_p->buf;
-    s_fb.uvc_fb.len = s_fb.cam_fb_p->len;
-    s_fb.uvc_fb.width = s_fb.cam_fb_p->width;
-    s_fb.uvc_fb.height = s_fb.cam_fb_p->height;
-    s_fb.uvc_fb.format = s_fb.cam_fb_p->format;
-    s_fb.uvc_fb.timestamp = s_fb.cam_fb_p->timestamp;
+#if CONFIG_CAMERA_PROFILE_LOW_LATENCY
+    // Only the newest queued frame is worth sending
+    fb_t *newer;
+    while ((newer = frame_ring_pop(&s_frame_ring)) != NULL) {
+        camera_slot_release(fb);
+        stream_stats_dropped(STREAM_STATS_DROP_SUPERSEDED);
+        fb = newer;
+    }
+#endif
+    xSemaphoreGive(s_capture.consumer);
+    xSemaphoreGive(s_capture.space);
 
-    if (s_fb.uvc_fb.len > UVC_MAX_FRAMESIZE_SIZE) {
-        ESP_LOGE(TAG, "Frame size %d is larger than max frame size %d", s_fb.uvc_fb.len, UVC_MAX_FRAMESIZE_SIZE);
-        esp_camera_fb_return(s_fb.cam_fb_p);
-        return NULL;
+    fb->sent_us = esp_timer_get_time();
+    if (s_first_frame_pending) {
+        camera_first_frame_log(fb->sent_us);
+    }
+    int64_t captured_us = (int64_t)fb->cam_fb_p->timestamp.tv_sec * 1000000 + fb->cam_fb_p->timestamp.tv_usec;
+    stream_stats_latency(STREAM_STATS_LAT_CAPTURE, (uint32_t)(fb->sent_us - captured_us));
+    stream_stats_latency(STREAM_STATS_LAT_WAIT, (uint32_t)(fb->sent_us - start_us));
+    stream_stats_sent(fb->uvc_fb.len);
+    return &fb->uvc_fb;
+}
+
+#if CONFIG_CAMERA_LCD_PREVIEW
+static void camera_preview_release(void *arg)
+{
+    camera_slot_release((fb_t *)arg);
+}
+
+// Lend a sent frame to the LCD preview, false if it skipped the frame
+static bool camera_preview_offer(fb_t *fb)
+{
+    // Only while another slot is free, so that the capture task never waits for the preview
+    if (frame_pool_in_flight(&s_fb_pool) >= CAMERA_FB_COUNT) {
+        return false;
+    }
+    camera_fb_t *cam = fb->cam_fb_p;
+    switch (s_uvc_params.format) {
+    case UVC_FORMAT_MJPEG:
+        return lcd_preview_offer(PREVIEW_SRC_JPEG, fb->uvc_fb.buf, fb->uvc_fb.len, 0, 0, fb);
+    case UVC_FORMAT_GRAY8:
+        // Converted in place
+        return lcd_preview_offer(PREVIEW_SRC_GRAY, cam->buf, fb->uvc_fb.len, fb->uvc_fb.width, fb->uvc_fb.height, fb);
+    default:
+        // YUY2 as sent, NV12 from the YUV422 capture it was converted from
+        return lcd_preview_offer(PREVIEW_SRC_YUYV, cam->buf, (size_t)fb->uvc_fb.width * fb->uvc_fb.height * 2,
+                                 fb->uvc_fb.width, fb->uvc_fb.height, fb);
     }
-    return &s_fb.uvc_fb;
 }
+#endif
 
 static void camera_fb_return_cb(uvc_fb_t *fb, void *cb_ctx)
 {
     (void)cb_ctx;
-    assert(fb == &s_fb.uvc_fb);
-    esp_camera_fb_return(s_fb.cam_fb_p);
+    // Map the UVC frame back to the slot that owns it
+    fb_t *owner = (fb_t *)((uint8_t *)fb - offsetof(fb_t, uvc_fb));
+    assert(owner >= s_fb && owner < s_fb + CAMERA_FB_COUNT);
+    stream_stats_latency(STREAM_STATS_LAT_HOLD, (uint32_t)(esp_timer_get_time() - owner->sent_us));
+#if CONFIG_CAMERA_LCD_PREVIEW
+    if (camera_preview_offer(owner)) {
+        // The preview releases the slot
+        return;
+    }
+#endif
+    camera_slot_release(owner);
 }
 
+#if CONFIG_CAMERA_STORE
+// Mode the last stream ran in, -1 if none or if it is no longer enabled
+static int camera_stored_mode(void)
+{
+    uint32_t key;
+    if (camera_store_load_mode(&key) != ESP_OK) {
+        return -1;
+    }
+    return uvc_mode_find(key >> 24, (key >> 12) & 0xfff, key & 0xfff);
+}
+#endif
+
+#if CONFIG_CAMERA_WARMUP
+// Probe and initialize the camera while USB enumerates, then park it until a stream starts
+static void camera_warmup_task(void *arg)
+{
+    int mode_id = (int)(intptr_t)arg;
+    const uvc_mode_t *mode = &UVC_MODES[mode_id];
+    int64_t start_us = esp_timer_get_time();
+
+    camera_uvc_params_set(mode->format, mode->frame.width, mode->frame.height, mode->frame.rate);
+    // The transfer buffer already fits the mode, so the UVC config is not touched here
+    if (camera_mode_start(mode_id) == ESP_OK) {
+        s_camera_idle = true;
+#if CONFIG_CAMERA_STANDBY
+        camera_standby(true);
+#endif
+        int64_t now_us = esp_timer_get_time();
+        ESP_LOGI(TAG, "Camera warmed up in %s %dx%d in %"PRId64" us, ready %"PRId64" us after boot", uvc_format_names[mode->format],
+                 mode->frame.width, mode->frame.height, now_us - start_us, now_us);
+    } else {
+        ESP_LOGW(TAG, "Camera warm-up failed, initializing on stream start");
+    }
+    xSemaphoreGive(s_warmup_done);
+    vTaskDelete(NULL);
+}
+#endif
+
 void app_main(void)
 {
     ESP_LOGI(TAG, "Selected Camera Board %s", CAMERA_MODULE_NAME);
-    uint8_t *uvc_buffer = (uint8_t *)malloc(UVC_MAX_FRAMESIZE_SIZE);
-    if (uvc_buffer == NULL) {
-        ESP_LOGE(TAG, "malloc frame buffer fail");
-        return;
+    ESP_LOGI(TAG, "Streaming profile: %s, %d frame buffers",
+             CAMERA_GRAB_MODE == CAMERA_GRAB_LATEST ? "lowest latency" : "smoothest throughput", CAMERA_FB_COUNT);
+    frame_pool_init(&s_fb_pool, CAMERA_FB_COUNT);
+    ESP_ERROR_CHECK(camera_capture_init());
+#if CONFIG_CAMERA_LCD_PREVIEW
+    if (lcd_preview_init(camera_preview_release) != ESP_OK) {
+        ESP_LOGW(TAG, "LCD preview unavailable");
     }
-
-    uvc_device_config_t config = {
-        .uvc_buffer = uvc_buffer,
-        .uvc_buffer_size = UVC_MAX_FRAMESIZE_SIZE,
+#endif
+#if CONFIG_CAMERA_LCD_EYES
+    if (eyes_ctrl_start() != ESP_OK) {
+        ESP_LOGW(TAG, "Eye animations unavailable");
+    }
+#endif
+    s_uvc_config = (uvc_device_config_t) {
         .start_cb = camera_start_cb,
         .fb_get_cb = camera_fb_get_cb,
         .fb_return_cb = camera_fb_return_cb,
         .stop_cb = camera_stop_cb,
     };
 
+    int boot_mode = UVC_MODE_DEFAULT;
+#if CONFIG_CAMERA_STORE
+    if (camera_store_init() == ESP_OK) {
+        int stored_mode = camera_stored_mode();
+        if (stored_mode >= 0) {
+            boot_mode = stored_mode;
+        }
+    } else {
+        ESP_LOGW(TAG, "NVS unavailable, mode and tuning are not remembered");
+    }
+#endif
+    ESP_ERROR_CHECK(uvc_buffer_alloc());
+    ESP_ERROR_CHECK(uvc_device_config(0, &s_uvc_config));
+#if CONFIG_CAMERA_WARMUP
+    s_warmup_done = xSemaphoreCreateBinary();
+    if (!s_warmup_done || xTaskCreate(camera_warmup_task, "cam_warmup", CAMERA_WARMUP_TASK_STACK, (void *)(intptr_t)boot_mode,
+                                      5, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the camera warm-up");
+        if (s_warmup_done) {
+            vSemaphoreDelete(s_warmup_done);
+            s_warmup_done = NULL;
+        }
+    }
+#else
+    (void)boot_mode;
+#endif
+
     ESP_LOGI(TAG, "====== UVC Configuration Information ======");
-    ESP_LOGI(TAG, "Format List");
-    ESP_LOGI(TAG, "\tFormat(1) = %s", "MJPEG");
-    
-    ESP_LOGI(TAG, "Frame List");
-    ESP_LOGI(TAG, "\tFrame(1) = %d * %d @%dfps (interval: %d)",
-             UVC_FRAMES_INFO[0][0].width, UVC_FRAMES_INFO[0][0].height,
-             UVC_FRAMES_INFO[0][0].rate, UVC_FRAMES_INFO[0][0].interval);
-    ESP_LOGI(TAG, "\tFrame(2) = %d * %d @%dfps (interval: %d)",
-             UVC_FRAMES_INFO[0][1].width, UVC_FRAMES_INFO[0][1].height,
-             UVC_FRAMES_INFO[0][1].rate, UVC_FRAMES_INFO[0][1].interval);
-    ESP_LOGI(TAG, "\tFrame(3) = %d * %d @%dfps (interval: %d)",
-             UVC_FRAMES_INFO[0][2].width, UVC_FRAMES_INFO[0][2].height,
-             UVC_FRAMES_INFO[0][2].rate, UVC_FRAMES_INFO[0][2].interval);
-    ESP_LOGI(TAG, "\tFrame(4) = %d * %d @%dfps (interval: %d)",
-             UVC_FRAMES_INFO[0][3].width, UVC_FRAMES_INFO[0][3].height,
-             UVC_FRAMES_INFO[0][3].rate, UVC_FRAMES_INFO[0][3].interval);
+    ESP_LOGI(TAG, "Mode List");
+    for (int i = 0; i < UVC_MODE_COUNT; i++) {
+        ESP_LOGI(TAG, "\tMode(%d) = %s %d * %d @%dfps (interval: %"PRIu32"), max %"PRIu32" bytes", i + 1,
+                 uvc_format_names[UVC_MODES[i].format], UVC_MODES[i].frame.width, UVC_MODES[i].frame.height,
+                 UVC_MODES[i].frame.rate, UVC_MODES[i].frame.interval, UVC_MODES[i].max_frame_bytes);
+    }
     ESP_LOGI(TAG, "===========================================");
 
-    ESP_ERROR_CHECK(uvc_device_config(0, &config));
     ESP_ERROR_CHECK(uvc_device_init());
 
     ESP_LOGI(TAG, "UVC device initialized. Waiting for USB host connection...");
 
-    // Main loop - just wait for callbacks
+    // Main loop - the callbacks do the work, only report what they counted
+    stream_stats_t stats[2] = { 0 };
+    int cur = 0;
+    int64_t report_us = esp_timer_get_time();
+#if CONFIG_CAMERA_LCD_EYES
+    bool usb_suspended = false;
+#endif
     while (1) {
         vTaskDelay(pdMS_TO_TICKS(100));
+#if CONFIG_CAMERA_LCD_EYES
+        // usb_device_uvc keeps the suspend callback of TinyUSB to itself, poll the state
+        if (tud_suspended() != usb_suspended) {
+            usb_suspended = !usb_suspended;
+            if (usb_suspended) {
+                eyes_ctrl_post(EYES_EVENT_SUSPEND);
+            }
+        }
+#endif
+        int64_t now_us = esp_timer_get_time();
+        if (now_us - report_us < STATS_REPORT_INTERVAL_US) {
+            continue;
+        }
+        cur ^= 1;
+        stream_stats_snapshot(&stats[cur]);
+        stream_stats_report(&stats[cur], &stats[cur ^ 1], now_us - report_us, s_uvc_params.frame_rate);
+
+        uvc_telemetry_t telemetry = {
+            .format = s_uvc_params.format,
+            .width = s_uvc_params.width,
+            .height = s_uvc_params.height,
+            .requested_fps = s_uvc_params.frame_rate,
+        };
+        if (s_uvc_params.format == UVC_FORMAT_MJPEG) {
+#if CONFIG_CAMERA_JPEG_RATE_CTRL
+            telemetry.jpeg_quality = s_rate_ctrl.quality;
+#else
+            telemetry.jpeg_quality = s_mode->jpeg_quality;
+#endif
+        }
+        uvc_telemetry_fill(&telemetry, &stats[cur], &stats[cur ^ 1], now_us - report_us);
+        uvc_telemetry_publish(&telemetry);
+        report_us = now_us;
+#if CONFIG_CAMERA_JPEG_RATE_CTRL
+        if (stats[cur].sent != stats[cur ^ 1].sent && s_uvc_params.format == UVC_FORMAT_MJPEG) {
+            ESP_LOGI(TAG, "JPEG rate ctrl: quality %d, avg %"PRIu32" bytes, %"PRIu32" frames, %"PRIu32" dropped, %"PRIu32" drops avoided",
+                     s_rate_ctrl.quality, s_rate_ctrl.avg_len, s_rate_ctrl.frames, s_rate_ctrl.dropped, s_rate_ctrl.avoided);
+        }
+#endif
+#if CONFIG_CAMERA_LCD_PREVIEW
+        if (stats[cur].sent != stats[cur ^ 1].sent) {
+            lcd_preview_stats_t preview;
+            lcd_preview_get_stats(&preview);
+            ESP_LOGI(TAG, "LCD preview: %"PRIu32" shown, %"PRIu32" skipped, %"PRIu32" failed, last frame %"PRIu32" us",
+                     preview.shown, preview.skipped, preview.failed, preview.busy_us);
+        }
+#endif
+#if CONFIG_CAMERA_LCD_EYES
+        eyes_ctrl_stats_t eyes;
+        eyes_ctrl_get_stats(&eyes);
+        ESP_LOGD(TAG, "Eyes: %"PRIu32" events, %"PRIu32" coalesced, %"PRIu32" animations",
+                 eyes.posted, eyes.coalesced, eyes.switches);
+#endif
     }
 }
@@ -0,0 +1,394 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "uvc_telemetry.h"
+#include "sensor_ctrl.h"
+#include "uvc_ctrl.h"
+
+static const char *TAG = "uvc_ctrl";
+
+// USB and UVC 1.5 descriptor types
+#define DESC_INTERFACE              0x04
+#define DESC_CS_INTERFACE           0x24
+#define UVC_CLASS_VIDEO             0x0E
+#define UVC_SUBCLASS_CONTROL        0x01
+#define VC_HEADER                   0x01
+#define VC_INPUT_TERMINAL           0x02
+#define VC_OUTPUT_TERMINAL          0x03
+#define VC_PROCESSING_UNIT          0x05
+#define VC_EXTENSION_UNIT           0x06
+#define VC_ENCODING_UNIT            0x07
+#define ITT_CAMERA                  0x0201
+
+// UVC requests
+#define UVC_SET_CUR                 0x01
+#define UVC_GET_CUR                 0x81
+#define UVC_GET_MIN                 0x82
+#define UVC_GET_MAX                 0x83
+#define UVC_GET_RES                 0x84
+#define UVC_GET_LEN                 0x85
+#define UVC_GET_INFO                0x86
+#define UVC_GET_DEF                 0x87
+#define UVC_INFO_GET                0x01
+#define UVC_INFO_SET                0x02
+#define UVC_AE_MODE_MANUAL          0x01
+#define UVC_AE_MODE_AUTO            0x02
+
+#define PU_DESC_LEN_MAX             13
+#define XU_DESC_LEN                 26
+
+#define CT  SENSOR_CTRL_UVC_UNIT_CT
+#define PU  SENSOR_CTRL_UVC_UNIT_PU
+#define XU  SENSOR_CTRL_UVC_UNIT_XU
+
+// Standard controls sensor_ctrl.c maps to, as the host sees them
+typedef struct {
+    uint8_t unit;       /*!< SENSOR_CTRL_UVC_UNIT_x */
+    uint8_t selector;   /*!< Control selector */
+    uint8_t bit;        /*!< Bit of the control in bmControls of the unit, selector - 1 on the XU */
+    uint8_t size;       /*!< wLength of the control */
+    bool is_signed;     /*!< The host reads the value as signed */
+} uvc_ctrl_t;
+
+static const uvc_ctrl_t s_ctrls[] = {
+    {CT, CT_AE_MODE_CONTROL,                        1,  1, false},
+    {PU, PU_BRIGHTNESS_CONTROL,                     0,  2, true},
+    {PU, PU_CONTRAST_CONTROL,                       1,  2, false},
+    {PU, PU_SATURATION_CONTROL,                     3,  2, false},
+    {PU, PU_SHARPNESS_CONTROL,                      4,  2, false},
+    {PU, PU_GAIN_CONTROL,                           9,  2, false},
+    {PU, PU_WHITE_BALANCE_TEMPERATURE_AUTO_CONTROL, 12, 1, false},
+    {XU, XU_EXPOSURE_LINES_CONTROL,                 1,  2, false},
+    {XU, XU_HFLIP_CONTROL,                          2,  1, false},
+    {XU, XU_VFLIP_CONTROL,                          3,  1, false},
+};
+
+_Static_assert(UVC_TELEMETRY_XU_SELECTOR == 1, "the telemetry takes the first bit of the Extension Unit");
+
+// Offsets in the descriptors of the first Video Control interface
+typedef struct {
+    size_t itf;     /*!< Standard interface descriptor */
+    size_t header;  /*!< Class-specific header */
+    size_t end;     /*!< End of the class-specific descriptors */
+    size_t ct;      /*!< Camera Terminal */
+    size_t ot;      /*!< Output Terminal fed by the Camera Terminal */
+} vc_layout_t;
+
+uint8_t const *__real_tud_descriptor_configuration_cb(uint8_t index);
+bool __real_videod_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request);
+
+static bool s_patch_done;
+static uint8_t *s_config;
+static uint8_t s_vc_itf;
+static uint8_t s_ct_id;
+// Data of the control transfer in progress, TinyUSB runs one at a time
+static uint8_t s_buf[sizeof(uvc_telemetry_t)];
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static bool vc_find(const uint8_t *desc, size_t total, vc_layout_t *vc)
+{
+    // Each descriptor is checked to lie within the total before any of its fields is read
+    size_t pos = 0;
+    while (1) {
+        if (pos + 2 > total || desc[pos] < 2 || pos + desc[pos] > total) {
+            return false;
+        }
+        if (desc[pos + 1] == DESC_INTERFACE && desc[pos] >= 9 && desc[pos + 5] == UVC_CLASS_VIDEO
+                && desc[pos + 6] == UVC_SUBCLASS_CONTROL) {
+            break;
+        }
+        pos += desc[pos];
+    }
+    vc->itf = pos;
+    vc->header = pos + desc[pos];
+    const uint8_t *h = desc + vc->header;
+    if (vc->header + 12 > total || h[0] < 12 || vc->header + h[0] > total || h[1] != DESC_CS_INTERFACE
+            || h[2] != VC_HEADER) {
+        return false;
+    }
+    vc->end = vc->header + get_u16(h + 5);
+    if (vc->end > total) {
+        return false;
+    }
+
+    // usb_device_uvc declares the Camera Terminal before the Output Terminal it feeds
+    vc->ct = 0;
+    vc->ot = 0;
+    for (pos = vc->header + h[0]; pos + 9 <= vc->end && desc[pos] >= 2 && pos + desc[pos] <= vc->end; pos += desc[pos]) {
+        const uint8_t *d = desc + pos;
+        if (d[1] != DESC_CS_INTERFACE || d[2] < VC_INPUT_TERMINAL || d[2] > VC_ENCODING_UNIT) {
+            continue;
+        }
+        if (d[3] == UVC_CTRL_PU_ID || d[3] == UVC_CTRL_XU_ID) {
+            // Already taken, the ids of this module would be ambiguous
+            return false;
+        }
+        if (d[2] == VC_INPUT_TERMINAL && get_u16(d + 4) == ITT_CAMERA && !vc->ct) {
+            vc->ct = pos;
+        } else if (d[2] == VC_OUTPUT_TERMINAL && vc->ct && d[7] == desc[vc->ct + 3] && !vc->ot) {
+            vc->ot = pos;
+        }
+    }
+    return vc->ct && vc->ot;
+}
+
+static void set_controls(uint8_t *bm_controls, uint8_t size, uint8_t unit)
+{
+    for (size_t i = 0; i < sizeof(s_ctrls) / sizeof(s_ctrls[0]); i++) {
+        if (s_ctrls[i].unit == unit && s_ctrls[i].bit < size * 8) {
+            bm_controls[s_ctrls[i].bit / 8] |= 1 << (s_ctrls[i].bit % 8);
+        }
+    }
+}
+
+static size_t pu_desc(uint8_t *d, uint8_t source, uint16_t bcd_uvc)
+{
+    // UVC 1.5 has a third byte of controls and the supported video standards
+    uint8_t control_size = bcd_uvc >= 0x0150 ? 3 : 2;
+    size_t len = 9 + control_size + (bcd_uvc >= 0x0150);
+    memset(d, 0, len);
+    d[0] = len;
+    d[1] = DESC_CS_INTERFACE;
+    d[2] = VC_PROCESSING_UNIT;
+    d[3] = UVC_CTRL_PU_ID;
+    d[4] = source;
+    // wMaxMultiplier 0, there is no digital zoom
+    d[7] = control_size;
+    set_controls(d + 8, control_size, PU);
+    return len;
+}
+
+static size_t xu_desc(uint8_t *d, uint8_t source)
+{
+    static const uint8_t guid[16] = { UVC_TELEMETRY_XU_GUID };
+    d[0] = XU_DESC_LEN;
+    d[1] = DESC_CS_INTERFACE;
+    d[2] = VC_EXTENSION_UNIT;
+    d[3] = UVC_CTRL_XU_ID;
+    memcpy(d + 4, guid, sizeof(guid));
+    d[21] = 1;          // bNrInPins
+    d[22] = source;     // baSourceID
+    d[23] = 1;          // bControlSize
+    d[24] = 1 << (UVC_TELEMETRY_XU_SELECTOR - 1);
+    set_controls(d + 24, 1, XU);
+    d[20] = __builtin_popcount(d[24]);  // bNumControls
+    d[25] = 0;          // iExtension
+    return XU_DESC_LEN;
+}
+
+// Copy of the descriptor with the units inserted at the end of the Video Control interface
+static uint8_t *vc_patch(const uint8_t *desc)
+{
+    uint16_t total = get_u16(desc + 2);
+    vc_layout_t vc;
+    if (!vc_find(desc, total, &vc)) {
+        return NULL;
+    }
+    uint8_t units[PU_DESC_LEN_MAX + XU_DESC_LEN];
+    size_t added = pu_desc(units, desc[vc.ct + 3], get_u16(desc + vc.header + 3));
+    added += xu_desc(units + added, UVC_CTRL_PU_ID);
+
+    uint8_t *out = malloc(total + added);
+    if (!out) {
+        return NULL;
+    }
+    memcpy(out, desc, vc.end);
+    memcpy(out + vc.end, units, added);
+    memcpy(out + vc.end + added, desc + vc.end, total - vc.end);
+    put_u16(out + 2, total + added);
+    put_u16(out + vc.header + 5, get_u16(desc + vc.header + 5) + added);
+    // The stream now passes through the Processing Unit and the Extension Unit
+    out[vc.ot + 7] = UVC_CTRL_XU_ID;
+    // bControlSize and bmControls of the Camera Terminal
+    uint8_t *ct = out + vc.ct;
+    if (ct[0] >= 15 && ct[0] >= 15 + ct[14]) {
+        set_controls(ct + 15, ct[14], CT);
+    }
+    s_vc_itf = out[vc.itf + 2];
+    s_ct_id = ct[3];
+    return out;
+}
+
+uint8_t const *__wrap_tud_descriptor_configuration_cb(uint8_t index)
+{
+    uint8_t const *desc = __real_tud_descriptor_configuration_cb(index);
+    // The descriptor of usb_device_uvc is static, TinyUSB keeps pointers into the copy
+    if (index == 0 && !s_patch_done) {
+        s_patch_done = true;
+        s_config = vc_patch(desc);
+        if (s_config) {
+            ESP_LOGI(TAG, "Processing Unit %d and Extension Unit %d added to interface %d", UVC_CTRL_PU_ID,
+                     UVC_CTRL_XU_ID, s_vc_itf);
+        } else {
+            ESP_LOGW(TAG, "Video Control interface not recognized, controls and telemetry not exposed");
+        }
+    }
+    return index == 0 && s_config ? s_config : desc;
+}
+
+static bool telemetry_request(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request)
+{
+    if (stage != CONTROL_STAGE_SETUP) {
+        return true;
+    }
+    uint16_t len;
+    switch (request->bRequest) {
+    case UVC_GET_CUR:
+        len = uvc_telemetry_read(s_buf, sizeof(uvc_telemetry_t));
+        break;
+    case UVC_GET_LEN:
+        put_u16(s_buf, sizeof(uvc_telemetry_t));
+        len = 2;
+        break;
+    case UVC_GET_INFO:
+        s_buf[0] = UVC_INFO_GET;
+        len = 1;
+        break;
+    default:
+        // Read-only, and a block of counters has no range
+        return false;
+    }
+    return tud_control_xfer(rhport, request, s_buf, len < request->wLength ? len : request->wLength);
+}
+
+static const uvc_ctrl_t *ctrl_find(uint8_t unit, uint8_t selector)
+{
+    for (size_t i = 0; i < sizeof(s_ctrls) / sizeof(s_ctrls[0]); i++) {
+        if (s_ctrls[i].unit == unit && s_ctrls[i].selector == selector) {
+            return &s_ctrls[i];
+        }
+    }
+    return NULL;
+}
+
+// Unsigned controls start at 0 on the host, AE mode is a bitmap of modes
+static int32_t to_uvc(const uvc_ctrl_t *ctrl, const sensor_ctrl_info_t *info, int value)
+{
+    if (ctrl->unit == CT && ctrl->selector == CT_AE_MODE_CONTROL) {
+        return value ? UVC_AE_MODE_AUTO : UVC_AE_MODE_MANUAL;
+    }
+    return ctrl->is_signed || info->min >= 0 ? value : value - info->min;
+}
+
+static bool from_uvc(const uvc_ctrl_t *ctrl, const sensor_ctrl_info_t *info, const uint8_t *buf, int *value)
+{
+    int32_t v = buf[0];
+    if (ctrl->size == 2) {
+        v = ctrl->is_signed ? (int16_t)get_u16(buf) : get_u16(buf);
+    } else if (ctrl->size == 4) {
+        // Above INT32_MAX is clamped like any value out of range
+        uint32_t u = get_u16(buf) | (uint32_t)get_u16(buf + 2) << 16;
+        v = u > INT32_MAX ? INT32_MAX : (int32_t)u;
+    }
+    if (ctrl->unit == CT && ctrl->selector == CT_AE_MODE_CONTROL) {
+        // Shutter and aperture priority are not supported
+        if (v != UVC_AE_MODE_MANUAL && v != UVC_AE_MODE_AUTO) {
+            return false;
+        }
+        *value = v == UVC_AE_MODE_AUTO;
+        return true;
+    }
+    *value = ctrl->is_signed || info->min >= 0 ? v : v + info->min;
+    return true;
+}
+
+static bool sensor_request(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request, uint8_t unit)
+{
+    uint8_t selector = request->wValue >> 8;
+    const uvc_ctrl_t *ctrl = ctrl_find(unit, selector);
+    int id = sensor_ctrl_find_uvc(unit, selector);
+    if (!ctrl || id < 0) {
+        return false;
+    }
+    const sensor_ctrl_info_t *info = sensor_ctrl_info(id);
+    bool ae_mode = unit == CT && selector == CT_AE_MODE_CONTROL;
+
+    if (request->bRequest == UVC_SET_CUR) {
+        if (stage == CONTROL_STAGE_SETUP) {
+            // The value arrives in the data stage
+            return request->wLength == ctrl->size && tud_control_xfer(rhport, request, s_buf, ctrl->size);
+        }
+        int value;
+        if (stage == CONTROL_STAGE_DATA) {
+            return from_uvc(ctrl, info, s_buf, &value) && sensor_ctrl_set(id, value) == ESP_OK;
+        }
+        return true;
+    }
+    if (stage != CONTROL_STAGE_SETUP) {
+        return true;
+    }
+
+    int32_t value;
+    uint16_t len = ctrl->size;
+    switch (request->bRequest) {
+    case UVC_GET_CUR:
+        value = to_uvc(ctrl, info, sensor_ctrl_get(id));
+        break;
+    case UVC_GET_MIN:
+    case UVC_GET_MAX:
+        // AE mode has no range, GET_RES lists its modes instead
+        if (ae_mode) {
+            return false;
+        }
+        value = to_uvc(ctrl, info, request->bRequest == UVC_GET_MIN ? info->min : info->max);
+        break;
+    case UVC_GET_RES:
+        value = ae_mode ? UVC_AE_MODE_MANUAL | UVC_AE_MODE_AUTO : 1;
+        break;
+    case UVC_GET_DEF:
+        value = to_uvc(ctrl, info, sensor_ctrl_default(id));
+        break;
+    case UVC_GET_LEN:
+        value = ctrl->size;
+        len = 2;
+        break;
+    case UVC_GET_INFO:
+        value = UVC_INFO_GET | UVC_INFO_SET;
+        len = 1;
+        break;
+    default:
+        return false;
+    }
+    for (int i = 0; i < len; i++) {
+        s_buf[i] = (uint32_t)value >> (8 * i);
+    }
+    return tud_control_xfer(rhport, request, s_buf, len < request->wLength ? len : request->wLength);
+}
+
+bool __wrap_videod_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request)
+{
+    if (s_config && request->bmRequestType_bit.type == TUSB_REQ_TYPE_CLASS
+            && request->bmRequestType_bit.recipient == TUSB_REQ_RCPT_INTERFACE
+            && (request->wIndex & 0xff) == s_vc_itf) {
+        uint8_t entity = request->wIndex >> 8;
+        if (entity == UVC_CTRL_XU_ID && request->wValue >> 8 == UVC_TELEMETRY_XU_SELECTOR) {
+            return telemetry_request(rhport, stage, request);
+        }
+        if (entity == UVC_CTRL_XU_ID) {
+            return sensor_request(rhport, stage, request, XU);
+        }
+        if (entity == UVC_CTRL_PU_ID) {
+            return sensor_request(rhport, stage, request, PU);
+        }
+        if (entity == s_ct_id) {
+            return sensor_request(rhport, stage, request, CT);
+        }
+    }
+    return __real_videod_control_xfer_cb(rhport, stage, request);
+}
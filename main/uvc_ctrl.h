@@ -0,0 +1,53 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tusb.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Entity ids added to the Video Control interface of the first camera */
+#define UVC_CTRL_PU_ID      3   /*!< Processing Unit with the image controls of sensor_ctrl.c */
+#define UVC_CTRL_XU_ID      4   /*!< Extension Unit with the telemetry and the sensor controls without a standard unit, the --unit of tools/uvc_telemetry.py */
+
+/**
+ * @brief Configuration descriptor of usb_device_uvc with the units of this module added
+ *
+ * Installed in place of tud_descriptor_configuration_cb with -Wl,--wrap, see
+ * CMakeLists.txt. The descriptor is copied on the first call: the Camera Terminal of the
+ * first camera declares the auto exposure control of sensor_ctrl.c, and a Processing Unit
+ * with the image controls and an Extension Unit with the telemetry, the exposure in lines
+ * and the flips are inserted between it and the Output Terminal. If the Video Control interface is not recognized the descriptor
+ * is returned unchanged.
+ *
+ * @param index configuration index
+ * @return configuration descriptor
+ */
+uint8_t const *__wrap_tud_descriptor_configuration_cb(uint8_t index);
+
+/**
+ * @brief Video Control requests of TinyUSB, installed in place of videod_control_xfer_cb
+ *
+ * Requests to the Camera Terminal and to the units added by
+ * __wrap_tud_descriptor_configuration_cb() are answered here, control values go through
+ * sensor_ctrl_set() and sensor_ctrl_get(). Everything else goes on to the video class
+ * driver of TinyUSB.
+ *
+ * @param rhport USB port
+ * @param stage CONTROL_STAGE_x of the transfer
+ * @param request setup packet
+ * @return false to stall the request
+ */
+bool __wrap_videod_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request);
+
+#ifdef __cplusplus
+}
+#endif
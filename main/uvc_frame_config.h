@@ -7,6 +7,8 @@
 #pragma once
 
 #include "stdint.h"
+#include "sdkconfig.h"
+#include "esp_camera.h"
 #include "usb_device_uvc.h"
 
 /**
@@ -30,15 +32,249 @@ typedef struct {
     uint32_t interval;   /*!< Frame interval in 100ns units */
 } uvc_frame_info_t;
 
-/* Frame configuration for default MJPEG format */
-static const uvc_frame_info_t UVC_FRAMES_INFO[][4] = {
+#define UVC_FRAMES_PER_FORMAT   4
+
+#define UVC_CONFIG_FORMAT_MJPEG_INDEX 0
+#define UVC_CONFIG_FORMAT_YUY2_INDEX 1
+#define UVC_CONFIG_FORMAT_GRAY8_INDEX 2
+#define UVC_CONFIG_FORMAT_NV12_INDEX 3
+
+/**
+ * @brief UVC mode, one entry of uvc_modes.def
+ */
+typedef struct {
+    uvc_format_t format;        /*!< UVC format */
+    uvc_frame_info_t frame;     /*!< Advertised frame */
+    framesize_t frame_size;     /*!< Sensor frame size */
+    int jpeg_quality;           /*!< Default JPEG quality, unused for raw formats */
+    uint32_t max_frame_bytes;   /*!< Largest frame that can be sent in this mode */
+} uvc_mode_t;
+
+#define UVC_MODE_ID(fmt, w, h)          UVC_MODE_##fmt##_##w##x##h
+#define UVC_MODE_KEY(format, w, h)      (((uint32_t)(format) << 24) | ((uint32_t)(w) << 12) | (uint32_t)(h))
+
+#if CONFIG_UVC_MODE_MJPEG_ROI
+/* The mode id is made of format and size, a second MJPEG mode of the same size would collide */
+#define UVC_ROI_SIZE_IS(w, h)   (CONFIG_UVC_ROI_WIDTH == (w) && CONFIG_UVC_ROI_HEIGHT == (h))
+#if (CONFIG_UVC_MODE_MJPEG_VGA && UVC_ROI_SIZE_IS(640, 480)) || (CONFIG_UVC_MODE_MJPEG_QVGA && UVC_ROI_SIZE_IS(320, 240)) \
+    || (CONFIG_UVC_MODE_MJPEG_HVGA && UVC_ROI_SIZE_IS(480, 320)) || (CONFIG_UVC_MODE_MJPEG_SVGA && UVC_ROI_SIZE_IS(800, 600)) \
+    || (CONFIG_UVC_MODE_MJPEG_HD && UVC_ROI_SIZE_IS(1280, 720)) || (CONFIG_UVC_MODE_MJPEG_FHD && UVC_ROI_SIZE_IS(1920, 1080))
+#error "The region of interest output size equals an enabled MJPEG mode, change UVC_ROI_WIDTH/UVC_ROI_HEIGHT or disable that mode"
+#endif
+#endif
+
+/* Mode ids, index into UVC_MODES */
+enum {
+#define UVC_MODE(fmt, w, h, fps, fs, q, bytes) UVC_MODE_ID(fmt, w, h),
+#include "uvc_modes.def"
+#undef UVC_MODE
+    UVC_MODE_COUNT
+};
+
+#if CONFIG_UVC_MODE_MJPEG_ROI
+/* Id of the region of interest mode, the indirection expands the sizes like the table does */
+#define UVC_MODE_ID_EXPANDED(fmt, w, h) UVC_MODE_ID(fmt, w, h)
+#define UVC_MODE_ROI    UVC_MODE_ID_EXPANDED(MJPEG, CONFIG_UVC_ROI_WIDTH, CONFIG_UVC_ROI_HEIGHT)
+#endif
+
+static const uvc_mode_t UVC_MODES[] = {
+#define UVC_MODE(fmt, w, h, fps, fs, q, bytes) \
+    [UVC_MODE_ID(fmt, w, h)] = {UVC_FORMAT_##fmt, {w, h, fps, 10000000 / (fps)}, fs, q, bytes},
+#include "uvc_modes.def"
+#undef UVC_MODE
+};
+
+/* Number of modes per format */
+#define UVC_MODE(fmt, w, h, fps, fs, q, bytes) + (UVC_FORMAT_##fmt == UVC_MODE_COUNT_FORMAT)
+enum {
+#define UVC_MODE_COUNT_FORMAT UVC_FORMAT_MJPEG
+    UVC_FRAME_NUM_MJPEG = 0
+#include "uvc_modes.def"
+    ,
+#undef UVC_MODE_COUNT_FORMAT
+#define UVC_MODE_COUNT_FORMAT UVC_FORMAT_YUY2
+    UVC_FRAME_NUM_YUY2 = 0
+#include "uvc_modes.def"
+    ,
+#undef UVC_MODE_COUNT_FORMAT
+#define UVC_MODE_COUNT_FORMAT UVC_FORMAT_GRAY8
+    UVC_FRAME_NUM_GRAY8 = 0
+#include "uvc_modes.def"
+    ,
+#undef UVC_MODE_COUNT_FORMAT
+#define UVC_MODE_COUNT_FORMAT UVC_FORMAT_NV12
+    UVC_FRAME_NUM_NV12 = 0
+#include "uvc_modes.def"
+#undef UVC_MODE_COUNT_FORMAT
+};
+#undef UVC_MODE
+
+_Static_assert(UVC_FRAME_NUM_MJPEG <= UVC_FRAMES_PER_FORMAT && UVC_FRAME_NUM_YUY2 <= UVC_FRAMES_PER_FORMAT
+               && UVC_FRAME_NUM_GRAY8 <= UVC_FRAMES_PER_FORMAT && UVC_FRAME_NUM_NV12 <= UVC_FRAMES_PER_FORMAT,
+               "Too many UVC modes enabled for one format");
+
+/*
+ * Frame configuration, one row per format. Each row includes the mode table with only
+ * the modes of its own format expanded.
+ */
+#define UVC_FRAME_TAKE(w, h, fps)   {w, h, fps, 10000000 / (fps)},
+#define UVC_FRAME_SKIP(w, h, fps)
+#define UVC_MODE(fmt, w, h, fps, fs, q, bytes) UVC_FRAME_##fmt(w, h, fps)
+static const uvc_frame_info_t UVC_FRAMES_INFO[][UVC_FRAMES_PER_FORMAT] = {
     {
         /* Format: UVC_FORMAT_MJPEG */
-        {640, 480, 30, 333333}, /* VGA 30fps - default for XIAO ESP32-S3 Sense */
-        {320, 240, 30, 333333}, /* QVGA 30fps */
-        {480, 320, 30, 333333}, /* HVGA 30fps */
-        {1280, 720, 15, 666666}, /* HD 15fps */
-    }
+#define UVC_FRAME_MJPEG UVC_FRAME_TAKE
+#define UVC_FRAME_YUY2  UVC_FRAME_SKIP
+#define UVC_FRAME_GRAY8 UVC_FRAME_SKIP
+#define UVC_FRAME_NV12  UVC_FRAME_SKIP
+#include "uvc_modes.def"
+    },
+    {
+        /* Format: UVC_FORMAT_YUY2 */
+#undef UVC_FRAME_MJPEG
+#undef UVC_FRAME_YUY2
+#define UVC_FRAME_MJPEG UVC_FRAME_SKIP
+#define UVC_FRAME_YUY2  UVC_FRAME_TAKE
+#include "uvc_modes.def"
+    },
+    {
+        /* Format: UVC_FORMAT_GRAY8 */
+#undef UVC_FRAME_YUY2
+#undef UVC_FRAME_GRAY8
+#define UVC_FRAME_YUY2  UVC_FRAME_SKIP
+#define UVC_FRAME_GRAY8 UVC_FRAME_TAKE
+#include "uvc_modes.def"
+    },
+    {
+        /* Format: UVC_FORMAT_NV12 */
+#undef UVC_FRAME_GRAY8
+#undef UVC_FRAME_NV12
+#define UVC_FRAME_GRAY8 UVC_FRAME_SKIP
+#define UVC_FRAME_NV12  UVC_FRAME_TAKE
+#include "uvc_modes.def"
+    },
 };
+#undef UVC_FRAME_MJPEG
+#undef UVC_FRAME_YUY2
+#undef UVC_FRAME_GRAY8
+#undef UVC_FRAME_NV12
+#undef UVC_MODE
 
-#define UVC_CONFIG_FORMAT_MJPEG_INDEX 0
+/*
+ * The usb_device_uvc component builds the descriptors the host sees from its own Kconfig
+ * frame list, not from UVC_FRAMES_INFO: CAM1 frame size and rate as the first frame, the
+ * UVC_MULTI_FRAME_* entries as the others. Stop the build if they do not advertise the
+ * modes of the table, in the same order, for the format the component was configured for.
+ */
+#if defined(CONFIG_FORMAT_MJPEG_CAM1) || defined(CONFIG_FORMAT_UNCOMPR_CAM1)
+#if !defined(CONFIG_UVC_CAM1_FRAMESIZE_WIDTH) || !defined(CONFIG_UVC_CAM1_FRAMERATE)
+#error "usb_device_uvc frame list options not found, check the frame check of uvc_frame_config.h against the component"
+#endif
+/* The component spells the height option without the second H */
+#if defined(CONFIG_UVC_CAM1_FRAMESIZE_HEIGT)
+#define UVC_CAM1_FIRST_HEIGHT   CONFIG_UVC_CAM1_FRAMESIZE_HEIGT
+#else
+#define UVC_CAM1_FIRST_HEIGHT   CONFIG_UVC_CAM1_FRAMESIZE_HEIGHT
+#endif
+/* The modes of a format follow each other in uvc_modes.def, MJPEG first and YUY2 next */
+#if CONFIG_FORMAT_MJPEG_CAM1
+#define UVC_CAM1_FORMAT         UVC_FORMAT_MJPEG
+#define UVC_CAM1_FIRST_MODE     0
+#define UVC_CAM1_MODE_NUM       UVC_FRAME_NUM_MJPEG
+#else
+#define UVC_CAM1_FORMAT         UVC_FORMAT_YUY2
+#define UVC_CAM1_FIRST_MODE     UVC_FRAME_NUM_MJPEG
+#define UVC_CAM1_MODE_NUM       UVC_FRAME_NUM_YUY2
+#endif
+#if CONFIG_UVC_CAM1_MULTI_FRAMESIZE
+#define UVC_CAM1_FRAME_NUM      4
+#define UVC_CAM1_FRAME(i, first, f1, f2, f3)    ((i) == 0 ? (first) : (i) == 1 ? (f1) : (i) == 2 ? (f2) : (f3))
+#define UVC_CAM1_WIDTH(i)   UVC_CAM1_FRAME(i, CONFIG_UVC_CAM1_FRAMESIZE_WIDTH, CONFIG_UVC_MULTI_FRAME_WIDTH_1, \
+                                           CONFIG_UVC_MULTI_FRAME_WIDTH_2, CONFIG_UVC_MULTI_FRAME_WIDTH_3)
+#define UVC_CAM1_HEIGHT(i)  UVC_CAM1_FRAME(i, UVC_CAM1_FIRST_HEIGHT, CONFIG_UVC_MULTI_FRAME_HEIGHT_1, \
+                                           CONFIG_UVC_MULTI_FRAME_HEIGHT_2, CONFIG_UVC_MULTI_FRAME_HEIGHT_3)
+#define UVC_CAM1_FPS(i)     UVC_CAM1_FRAME(i, CONFIG_UVC_CAM1_FRAMERATE, CONFIG_UVC_MULTI_FRAME_FPS_1, \
+                                           CONFIG_UVC_MULTI_FRAME_FPS_2, CONFIG_UVC_MULTI_FRAME_FPS_3)
+#else
+#define UVC_CAM1_FRAME_NUM      1
+#define UVC_CAM1_WIDTH(i)   CONFIG_UVC_CAM1_FRAMESIZE_WIDTH
+#define UVC_CAM1_HEIGHT(i)  UVC_CAM1_FIRST_HEIGHT
+#define UVC_CAM1_FPS(i)     CONFIG_UVC_CAM1_FRAMERATE
+#endif
+
+_Static_assert(UVC_CAM1_MODE_NUM == UVC_CAM1_FRAME_NUM,
+               "usb_device_uvc advertises another number of frames than uvc_modes.def enables for its format");
+#define UVC_MODE(fmt, w, h, fps, fs, q, bytes) \
+    && (UVC_FORMAT_##fmt != UVC_CAM1_FORMAT || (UVC_CAM1_WIDTH(UVC_MODE_ID(fmt, w, h) - UVC_CAM1_FIRST_MODE) == (w) \
+        && UVC_CAM1_HEIGHT(UVC_MODE_ID(fmt, w, h) - UVC_CAM1_FIRST_MODE) == (h) \
+        && UVC_CAM1_FPS(UVC_MODE_ID(fmt, w, h) - UVC_CAM1_FIRST_MODE) == (fps)))
+_Static_assert(1
+#include "uvc_modes.def"
+               , "usb_device_uvc frames differ from uvc_modes.def: UVC_CAM1_FRAMESIZE_* and UVC_CAM1_FRAMERATE "
+               "must be its first mode, UVC_MULTI_FRAME_*_1..3 the next ones, in order");
+#undef UVC_MODE
+#endif
+
+/*
+ * Whether a host can negotiate the modes of a format. usb_device_uvc advertises its CAM1
+ * format only, without the component configuration (host_sim) every format counts.
+ */
+#ifdef UVC_CAM1_FORMAT
+#define UVC_FORMAT_NEGOTIABLE(format)   ((format) == UVC_CAM1_FORMAT)
+/* Mode the camera is warmed up in when none was stored */
+#define UVC_MODE_DEFAULT                UVC_CAM1_FIRST_MODE
+#else
+#define UVC_FORMAT_NEGOTIABLE(format)   1
+#define UVC_MODE_DEFAULT                0
+#endif
+
+/*
+ * Compile time maxima over the enabled modes a host can negotiate: the size of a union is
+ * the size of its largest member, one array member per mode.
+ */
+#define UVC_MODE(fmt, w, h, fps, fs, q, bytes) uint8_t fmt##_##w##x##h[UVC_FORMAT_NEGOTIABLE(UVC_FORMAT_##fmt) ? (bytes) : 1];
+typedef union {
+    uint8_t none;
+#include "uvc_modes.def"
+} uvc_max_frame_bytes_t;
+#undef UVC_MODE
+
+#define UVC_MODE(fmt, w, h, fps, fs, q, bytes) \
+    uint8_t fmt##_##w##x##h[UVC_FORMAT_##fmt == UVC_FORMAT_NV12 && UVC_FORMAT_NEGOTIABLE(UVC_FORMAT_##fmt) ? (bytes) : 1];
+typedef union {
+    uint8_t none;
+#include "uvc_modes.def"
+} uvc_max_nv12_frame_bytes_t;
+#undef UVC_MODE
+
+#define UVC_MODE(fmt, w, h, fps, fs, q, bytes) \
+    uint8_t fmt##_##w##x##h[UVC_FORMAT_##fmt == UVC_FORMAT_MJPEG && UVC_FORMAT_NEGOTIABLE(UVC_FORMAT_##fmt) ? (fs) + 1 : 1];
+typedef union {
+    uint8_t none;
+#include "uvc_modes.def"
+} uvc_max_mjpeg_frame_size_t;
+#undef UVC_MODE
+
+/* Largest frame of any negotiable mode, in bytes */
+#define UVC_MAX_FRAME_BYTES         sizeof(uvc_max_frame_bytes_t)
+/* Largest NV12 frame, in bytes */
+#define UVC_MAX_NV12_FRAME_BYTES    sizeof(uvc_max_nv12_frame_bytes_t)
+/* Largest sensor frame size used by MJPEG modes */
+#define UVC_MAX_MJPEG_FRAME_SIZE    ((framesize_t)(sizeof(uvc_max_mjpeg_frame_size_t) - 1))
+
+/**
+ * @brief Find the mode negotiated by the host
+ *
+ * @return index into UVC_MODES, or -1 if the mode is not enabled or its format not negotiable
+ */
+static inline int uvc_mode_find(uvc_format_t format, int width, int height)
+{
+    switch (UVC_MODE_KEY(format, width, height)) {
+#define UVC_MODE(fmt, w, h, fps, fs, q, bytes) \
+    case UVC_MODE_KEY(UVC_FORMAT_##fmt, w, h): return UVC_FORMAT_NEGOTIABLE(UVC_FORMAT_##fmt) ? UVC_MODE_ID(fmt, w, h) : -1;
+#include "uvc_modes.def"
+#undef UVC_MODE
+    default:
+        return -1;
+    }
+}
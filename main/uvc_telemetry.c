@@ -0,0 +1,61 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "uvc_telemetry.h"
+
+// The host decoder hard codes these offsets, keep them in sync with tools/uvc_telemetry.py
+_Static_assert(sizeof(uvc_telemetry_t) == 48, "uvc_telemetry_t layout changed");
+_Static_assert(offsetof(uvc_telemetry_t, uptime_ms) == 8, "uvc_telemetry_t layout changed");
+_Static_assert(offsetof(uvc_telemetry_t, fps_x10) == 28, "uvc_telemetry_t layout changed");
+_Static_assert(offsetof(uvc_telemetry_t, heap_internal_free) == 32, "uvc_telemetry_t layout changed");
+_Static_assert(offsetof(uvc_telemetry_t, capture_p99_us) == 44, "uvc_telemetry_t layout changed");
+
+static uvc_telemetry_t s_telemetry = {
+    .version = UVC_TELEMETRY_VERSION,
+    .size = sizeof(uvc_telemetry_t),
+};
+static portMUX_TYPE s_telemetry_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void uvc_telemetry_fill(uvc_telemetry_t *out, const stream_stats_t *cur, const stream_stats_t *prev, int64_t elapsed_us)
+{
+    out->version = UVC_TELEMETRY_VERSION;
+    out->size = sizeof(uvc_telemetry_t);
+    out->uptime_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    out->frames_captured = cur->captured;
+    out->frames_sent = cur->sent;
+    out->frames_dropped = 0;
+    for (int i = 0; i < STREAM_STATS_DROP_MAX; i++) {
+        out->frames_dropped += cur->dropped[i];
+    }
+    out->fb_get_empty = cur->empty;
+    out->fps_x10 = elapsed_us > 0 ? (uint16_t)((uint64_t)(cur->sent - prev->sent) * 10000000 / elapsed_us) : 0;
+    out->heap_internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    out->heap_psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    out->capture_p50_us = stream_stats_percentile(cur, prev, STREAM_STATS_LAT_CAPTURE, 50);
+    out->capture_p99_us = stream_stats_percentile(cur, prev, STREAM_STATS_LAT_CAPTURE, 99);
+}
+
+void uvc_telemetry_publish(const uvc_telemetry_t *telemetry)
+{
+    portENTER_CRITICAL(&s_telemetry_lock);
+    s_telemetry = *telemetry;
+    portEXIT_CRITICAL(&s_telemetry_lock);
+}
+
+size_t uvc_telemetry_read(uint8_t *buf, size_t len)
+{
+    if (len > sizeof(s_telemetry)) {
+        len = sizeof(s_telemetry);
+    }
+    portENTER_CRITICAL(&s_telemetry_lock);
+    memcpy(buf, &s_telemetry, len);
+    portEXIT_CRITICAL(&s_telemetry_lock);
+    return len;
+}
@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "stream_stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Vendor Extension Unit {5d0e4b2c-8f4a-4f6e-9c1b-3a7e2d51c0f1} exposing the telemetry */
+#define UVC_TELEMETRY_XU_GUID   0x2c, 0x4b, 0x0e, 0x5d, 0x4a, 0x8f, 0x6e, 0x4f, \
+                                0x9c, 0x1b, 0x3a, 0x7e, 0x2d, 0x51, 0xc0, 0xf1
+#define UVC_TELEMETRY_XU_SELECTOR   0x01    /*!< Read-only control, GET_CUR returns uvc_telemetry_t */
+#define UVC_TELEMETRY_VERSION       1
+
+/**
+ * @brief Pipeline telemetry as returned to the host, little endian and packed
+ *
+ * The layout is part of the host interface: fields are only ever appended, and the
+ * version is bumped when the meaning of an existing field changes. Counters are
+ * cumulative since boot and wrap, rates and percentiles cover the last report window.
+ * The host decoder is tools/uvc_telemetry.py.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t version;            /*!< UVC_TELEMETRY_VERSION */
+    uint8_t size;               /*!< sizeof(uvc_telemetry_t) */
+    uint8_t format;             /*!< uvc_format_t of the current stream */
+    uint8_t jpeg_quality;       /*!< JPEG quality applied to the encoder, 0-63 */
+    uint16_t width;             /*!< Frame width of the current stream */
+    uint16_t height;            /*!< Frame height of the current stream */
+    uint32_t uptime_ms;         /*!< Time since boot */
+    uint32_t frames_captured;   /*!< Frames taken from the driver */
+    uint32_t frames_sent;       /*!< Frames handed to UVC */
+    uint32_t frames_dropped;    /*!< Frames captured but not sent, all reasons */
+    uint32_t fb_get_empty;      /*!< Frame requests that found no frame */
+    uint16_t fps_x10;           /*!< Achieved frame rate, in 0.1 fps */
+    uint16_t requested_fps;     /*!< Frame rate negotiated by the host */
+    uint32_t heap_internal_free; /*!< Free internal RAM in bytes */
+    uint32_t heap_psram_free;   /*!< Free PSRAM in bytes */
+    uint32_t capture_p50_us;    /*!< Median capture to hand-off latency */
+    uint32_t capture_p99_us;    /*!< 99th percentile capture to hand-off latency */
+} uvc_telemetry_t;
+
+/**
+ * @brief Fill the counters, rates and percentiles from two statistics snapshots
+ *
+ * Stream fields (format, size, quality, requested rate) are left to the caller.
+ *
+ * @param out telemetry to fill
+ * @param cur newer snapshot
+ * @param prev older snapshot
+ * @param elapsed_us time between the snapshots
+ */
+void uvc_telemetry_fill(uvc_telemetry_t *out, const stream_stats_t *cur, const stream_stats_t *prev, int64_t elapsed_us);
+
+/**
+ * @brief Make a filled telemetry block the one returned to the host
+ *
+ * @param telemetry telemetry to publish, copied
+ */
+void uvc_telemetry_publish(const uvc_telemetry_t *telemetry);
+
+/**
+ * @brief Copy the last published telemetry, for the Extension Unit GET_CUR request
+ *
+ * @param buf destination
+ * @param len size of buf, the copy is truncated to it
+ * @return bytes copied
+ */
+size_t uvc_telemetry_read(uint8_t *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
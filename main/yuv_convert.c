@@ -0,0 +1,85 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdint.h>
+#include "yuv_convert.h"
+
+// Word access to frame buffers that are also accessed bytewise
+typedef uint32_t __attribute__((may_alias)) word_t;
+
+void yuv422_to_gray8(const uint8_t *src, uint8_t *dst, size_t pixels)
+{
+    size_t i = 0;
+
+    if ((((uintptr_t)src | (uintptr_t)dst) & 3) == 0) {
+        // 4 pixels per iteration: two little endian YUYV words in, one word of luma out.
+        // Both source words are loaded before the store, so dst may alias src.
+        const word_t *s = (const word_t *)src;
+        word_t *d = (word_t *)dst;
+        for (; i + 4 <= pixels; i += 4) {
+            uint32_t w0 = s[0];
+            uint32_t w1 = s[1];
+            uint32_t y01 = (w0 & 0xff) | ((w0 >> 8) & 0xff00);
+            uint32_t y23 = (w1 & 0xff) | ((w1 >> 8) & 0xff00);
+            *d++ = y01 | (y23 << 16);
+            s += 2;
+        }
+    }
+
+    for (; i < pixels; i++) {
+        dst[i] = src[2 * i];
+    }
+}
+
+// Per byte rounded average of two words
+static inline uint32_t avg_u8x4(uint32_t a, uint32_t b)
+{
+    return (a | b) - (((a ^ b) >> 1) & 0x7f7f7f7f);
+}
+
+static void yuv422_to_nv12_rows(const uint8_t *s0, const uint8_t *s1, uint8_t *y0, uint8_t *y1, uint8_t *uv, size_t width)
+{
+    size_t x = 0;
+
+    if ((((uintptr_t)s0 | (uintptr_t)s1 | (uintptr_t)y0 | (uintptr_t)y1 | (uintptr_t)uv) & 3) == 0) {
+        // 4 pixels of both rows per iteration
+        const word_t *a = (const word_t *)s0;
+        const word_t *b = (const word_t *)s1;
+        for (; x + 4 <= width; x += 4) {
+            uint32_t a0 = a[0], a1 = a[1];
+            uint32_t b0 = b[0], b1 = b[1];
+            *(word_t *)(y0 + x) = (a0 & 0xff) | ((a0 >> 8) & 0xff00) | ((a1 & 0xff) << 16) | ((a1 << 8) & 0xff000000);
+            *(word_t *)(y1 + x) = (b0 & 0xff) | ((b0 >> 8) & 0xff00) | ((b1 & 0xff) << 16) | ((b1 << 8) & 0xff000000);
+            uint32_t c0 = avg_u8x4(a0, b0);
+            uint32_t c1 = avg_u8x4(a1, b1);
+            *(word_t *)(uv + x) = ((c0 >> 8) & 0xff) | ((c0 >> 16) & 0xff00) | ((c1 << 8) & 0xff0000) | (c1 & 0xff000000);
+            a += 2;
+            b += 2;
+        }
+    }
+
+    for (; x < width; x += 2) {
+        y0[x] = s0[2 * x];
+        y0[x + 1] = s0[2 * x + 2];
+        y1[x] = s1[2 * x];
+        y1[x + 1] = s1[2 * x + 2];
+        uv[x] = (s0[2 * x + 1] + s1[2 * x + 1] + 1) >> 1;
+        uv[x + 1] = (s0[2 * x + 3] + s1[2 * x + 3] + 1) >> 1;
+    }
+}
+
+void yuv422_to_nv12(const uint8_t *src, uint8_t *dst, size_t width, size_t height)
+{
+    size_t stride = width * 2;
+    uint8_t *uv = dst + width * height;
+
+    for (size_t y = 0; y < height; y += 2) {
+        yuv422_to_nv12_rows(src, src + stride, dst, dst + width, uv, width);
+        src += 2 * stride;
+        dst += 2 * width;
+        uv += width;
+    }
+}
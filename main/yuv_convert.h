@@ -0,0 +1,40 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Extract the luma plane from a packed YUV422 (YUYV) frame
+ *
+ * @param src packed YUYV pixels, 2 bytes per pixel
+ * @param dst output, 1 byte per pixel. May be the same buffer as src
+ * @param pixels number of pixels, must be even
+ */
+void yuv422_to_gray8(const uint8_t *src, uint8_t *dst, size_t pixels);
+
+/**
+ * @brief Convert a packed YUV422 (YUYV) frame to NV12
+ *
+ * Works on pairs of rows in a single pass: both luma rows are copied out and the
+ * chroma of the two rows is averaged into one interleaved UV row.
+ *
+ * @param src packed YUYV pixels, 2 bytes per pixel
+ * @param dst output of width * height * 3 / 2 bytes, must not overlap src
+ * @param width frame width, must be even
+ * @param height frame height, must be even
+ */
+void yuv422_to_nv12(const uint8_t *src, uint8_t *dst, size_t width, size_t height);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,362 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: Apache-2.0
+"""
+Convert a GIF animation into the pre-decoded format of eyes_show/eyes_anim.h.
+
+The GIF is decoded and composited once, at build time. Frame 0 is stored whole, every
+later frame only as the bounding box of the pixels that differ from the frame before.
+Pixels are RLE encoded as 8-bit indices into one RGB565 palette per animation. One
+extra delta turns the last frame back into the first, so a looping animation never
+goes through a full frame again.
+
+The input is a .gif file or one of the LVGL image sources of eyes_show, whose byte
+array holds the GIF. Transparent pixels become LV_COLOR_CHROMA_KEY.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+# Token layout, must match eyes_anim.h
+OP_LITERAL = 0x00
+OP_SKIP = 0x40
+OP_RUN = 0x80
+COUNT_MASK = 0x3f
+COUNT_MAX = 0xffff
+
+# Shortest run that is cheaper as a run than as literal pixels
+MIN_RUN = 3
+
+
+def load_gif(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:3] == b'GIF':
+        return data
+    # LVGL image source, take the first byte array
+    text = data.decode('utf-8', 'replace')
+    body = re.search(r'\[\]\s*=\s*\{(.*?)\};', text, re.S)
+    if not body:
+        raise ValueError('%s holds no byte array' % path)
+    # Drop the colour depth variants a converter may have appended
+    array = body.group(1).split('#if', 1)[0]
+    gif = bytes(int(v, 16) for v in re.findall(r'0x([0-9a-fA-F]{1,2})\b', array))
+    if gif[:3] != b'GIF':
+        raise ValueError('%s does not hold a GIF' % path)
+    return gif
+
+
+def lzw_decode(data, min_code_size, pixel_count):
+    clear = 1 << min_code_size
+    end = clear + 1
+    out = bytearray()
+    code_size = min_code_size + 1
+    table = [bytes([i]) for i in range(clear)] + [b'', b'']
+    prev = None
+    bits = 0
+    nbits = 0
+    pos = 0
+    while len(out) < pixel_count:
+        while nbits < code_size:
+            if pos >= len(data):
+                return bytes(out)
+            bits |= data[pos] << nbits
+            nbits += 8
+            pos += 1
+        code = bits & ((1 << code_size) - 1)
+        bits >>= code_size
+        nbits -= code_size
+        if code == clear:
+            code_size = min_code_size + 1
+            del table[clear + 2:]
+            prev = None
+            continue
+        if code == end:
+            break
+        if prev is None:
+            entry = table[code]
+        elif code < len(table):
+            entry = table[code]
+            table.append(prev + entry[:1])
+        else:
+            entry = prev + prev[:1]
+            table.append(entry)
+        out += entry
+        prev = entry
+        if len(table) == 1 << code_size and code_size < 12:
+            code_size += 1
+    return bytes(out[:pixel_count])
+
+
+def deinterlace(pixels, w, h):
+    rows = [pixels[y * w:(y + 1) * w] for y in range(h)]
+    order = list(range(0, h, 8)) + list(range(4, h, 8)) + list(range(2, h, 4)) + list(range(1, h, 2))
+    out = [None] * h
+    for src, dst in enumerate(order):
+        out[dst] = rows[src]
+    return b''.join(out)
+
+
+def read_sub_blocks(gif, pos):
+    chunks = []
+    while gif[pos]:
+        chunks.append(gif[pos + 1:pos + 1 + gif[pos]])
+        pos += 1 + gif[pos]
+    return b''.join(chunks), pos + 1
+
+
+def read_palette(gif, pos, flags):
+    size = 3 << ((flags & 7) + 1)
+    raw = gif[pos:pos + size]
+    return [tuple(raw[i:i + 3]) for i in range(0, size, 3)], pos + size
+
+
+def decode_gif(gif):
+    """Composite all frames, as lists of (r, g, b) or None for transparent pixels."""
+    width = gif[6] | gif[7] << 8
+    height = gif[8] | gif[9] << 8
+    flags = gif[10]
+    bg_index = gif[11]
+    pos = 13
+    global_palette = []
+    if flags & 0x80:
+        global_palette, pos = read_palette(gif, pos, flags)
+
+    frames = []
+    loop_count = 1
+    gce = {'disposal': 0, 'delay': 0, 'transparent': None}
+    bg = global_palette[bg_index] if bg_index < len(global_palette) else (0, 0, 0)
+    canvas = [bg] * (width * height)
+    while pos < len(gif):
+        block = gif[pos]
+        if block == 0x21:
+            label = gif[pos + 1]
+            payload, next_pos = read_sub_blocks(gif, pos + 2)
+            if label == 0xf9:
+                packed = payload[0]
+                gce = {
+                    'disposal': (packed >> 2) & 7,
+                    'delay': payload[1] | payload[2] << 8,
+                    'transparent': payload[3] if packed & 1 else None,
+                }
+            elif label == 0xff and payload[:11] == b'NETSCAPE2.0':
+                loop_count = payload[12] | payload[13] << 8
+            pos = next_pos
+        elif block == 0x2c:
+            fx, fy, fw, fh = (gif[pos + 1 + i] | gif[pos + 2 + i] << 8 for i in range(0, 8, 2))
+            fflags = gif[pos + 9]
+            pos += 10
+            palette = global_palette
+            if fflags & 0x80:
+                palette, pos = read_palette(gif, pos, fflags)
+            min_code_size = gif[pos]
+            lzw, pos = read_sub_blocks(gif, pos + 1)
+            pixels = lzw_decode(lzw, min_code_size, fw * fh)
+            if fflags & 0x40:
+                pixels = deinterlace(pixels, fw, fh)
+
+            previous = canvas[:] if gce['disposal'] == 3 else None
+            tindex = gce['transparent']
+            for y in range(fh):
+                row = (fy + y) * width + fx
+                for x in range(fw):
+                    i = y * fw + x
+                    if i < len(pixels) and pixels[i] != tindex:
+                        canvas[row + x] = palette[pixels[i]]
+            # GIF delays are in 10 ms units, browsers show 0 as 100 ms
+            frames.append((canvas[:], (gce['delay'] or 10) * 10))
+
+            if gce['disposal'] == 2:
+                fill = None if tindex is not None else bg
+                for y in range(fh):
+                    row = (fy + y) * width + fx
+                    canvas[row:row + fw] = [fill] * fw
+            elif gce['disposal'] == 3:
+                canvas = previous
+            gce = {'disposal': 0, 'delay': 0, 'transparent': None}
+        elif block == 0x3b:
+            break
+        else:
+            raise ValueError('unknown GIF block 0x%02x at %d' % (block, pos))
+    return width, height, loop_count, frames
+
+
+def rgb565(px, chroma_key):
+    if px is None:
+        return chroma_key
+    c = (px[0] >> 3) << 11 | (px[1] >> 2) << 5 | px[2] >> 3
+    # An opaque pixel must not turn transparent
+    return c ^ 1 if c == chroma_key else c
+
+
+def build_palette(frames, chroma_key):
+    """RGB565 palette and every frame as indices into it."""
+    palette = {}
+    indexed = []
+    for frame in frames:
+        row = bytearray()
+        for px in frame:
+            c = rgb565(px, chroma_key)
+            if c not in palette:
+                palette[c] = len(palette)
+            row.append(palette[c] if palette[c] < 256 else 0)
+        indexed.append(row)
+    if len(palette) > 256:
+        raise ValueError('%d colors after conversion, at most 256 are supported' % len(palette))
+    return list(palette), indexed
+
+
+def changed_area(prev, cur, width, height):
+    if prev is None:
+        return 0, 0, width, height
+    diff = [i for i in range(len(cur)) if cur[i] != prev[i]]
+    if not diff:
+        return 0, 0, 0, 0
+    ys = [i // width for i in diff]
+    xs = [i % width for i in diff]
+    x0, y0 = min(xs), min(ys)
+    return x0, y0, max(xs) - x0 + 1, max(ys) - y0 + 1
+
+
+def count_token(op, n):
+    if n <= COUNT_MASK:
+        return [op | n]
+    return [op, n & 0xff, n >> 8]
+
+
+def encode(prev, cur, area, width):
+    """RLE bytes of one area."""
+    x0, y0, w, h = area
+    pixels = bytearray()
+    keep = []
+    for y in range(y0, y0 + h):
+        row = y * width
+        pixels += cur[row + x0:row + x0 + w]
+        keep += [prev is not None and prev[i] == cur[i] for i in range(row + x0, row + x0 + w)]
+
+    out = bytearray()
+    literal = bytearray()
+
+    def flush():
+        while literal:
+            n = min(len(literal), COUNT_MAX)
+            out.extend(count_token(OP_LITERAL, n))
+            out.extend(literal[:n])
+            del literal[:n]
+
+    i = 0
+    while i < len(pixels):
+        j = i
+        if keep[i]:
+            while j < len(pixels) and keep[j] and j - i < COUNT_MAX:
+                j += 1
+            # Short unchanged gaps are cheaper rewritten than skipped
+            if j - i >= 2 or not literal:
+                flush()
+                out.extend(count_token(OP_SKIP, j - i))
+                i = j
+                continue
+        j = i
+        while j < len(pixels) and pixels[j] == pixels[i] and j - i < COUNT_MAX:
+            j += 1
+        if j - i >= MIN_RUN:
+            flush()
+            out.extend(count_token(OP_RUN, j - i))
+            out.append(pixels[i])
+            i = j
+        else:
+            literal.append(pixels[i])
+            i += 1
+    flush()
+    return out
+
+
+def generate(src_name, name, width, height, loop_count, frames, chroma_key):
+    palette, pixels = build_palette([f for f, _ in frames], chroma_key)
+    entries = []
+    data = bytearray()
+    for n in range(len(frames) + 1):
+        if n == 0:
+            prev, cur, delay = None, pixels[0], frames[0][1]
+        elif n < len(frames):
+            prev, cur, delay = pixels[n - 1], pixels[n], frames[n][1]
+        else:
+            # Back from the last frame to the first
+            prev, cur, delay = pixels[-1], pixels[0], frames[0][1]
+        area = changed_area(prev, cur, width, height)
+        entries.append((area, delay, len(data)))
+        if area[2]:
+            data += encode(prev, cur, area, width)
+
+    lines = [
+        '/*',
+        ' * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD',
+        ' *',
+        ' * SPDX-License-Identifier: Apache-2.0',
+        ' */',
+        '',
+        '/* Generated by tools/eyes_anim_convert.py from %s, do not edit */' % src_name,
+        '',
+        '#include "eyes_anim.h"',
+        '',
+        'static const uint16_t %s_palette[] = {' % name,
+    ]
+    for i in range(0, len(palette), 6):
+        lines.append('    ' + ', '.join('EYES_ANIM_PX(0x%04x)' % c for c in palette[i:i + 6]) + ',')
+    lines += ['};', '', 'static const uint8_t %s_data[] = {' % name]
+    for i in range(0, len(data), 16):
+        lines.append('    ' + ', '.join('0x%02x' % b for b in data[i:i + 16]) + ',')
+    lines += ['};', '', 'static const eyes_anim_frame_t %s_frames[] = {' % name]
+    for (x, y, w, h), delay, offset in entries:
+        lines.append('    {{%d, %d, %d, %d}, %d, %d},' % (x, y, w, h, delay, offset))
+    lines += [
+        '};',
+        '',
+        'const eyes_anim_t %s = {' % name,
+        '    .width = %d,' % width,
+        '    .height = %d,' % height,
+        '    .frame_count = %d,' % len(frames),
+        '    .loop_count = %d,' % loop_count,
+        '    .palette = %s_palette,' % name,
+        '    .frames = %s_frames,' % name,
+        '    .data = %s_data,' % name,
+        '};',
+        '',
+    ]
+    return '\n'.join(lines), len(data) + len(palette) * 2
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('input', help='.gif file or LVGL image source holding a GIF')
+    parser.add_argument('output', help='generated C source')
+    parser.add_argument('--name', help='symbol of the eyes_anim_t (default: from the output file name)')
+    parser.add_argument('--chroma-key', type=lambda v: int(v, 0), default=0x00ff00,
+                        help='LV_COLOR_CHROMA_KEY as 0xRRGGBB (default 0x00ff00)')
+    args = parser.parse_args()
+
+    name = args.name or os.path.splitext(os.path.basename(args.output))[0]
+    ck = args.chroma_key
+    chroma_key = ((ck >> 19) & 0x1f) << 11 | ((ck >> 10) & 0x3f) << 5 | (ck >> 3) & 0x1f
+    try:
+        width, height, loop_count, frames = decode_gif(load_gif(args.input))
+    except (ValueError, IndexError) as e:
+        print('%s: %s' % (args.input, e), file=sys.stderr)
+        return 1
+    if not frames:
+        print('%s: no frame' % args.input, file=sys.stderr)
+        return 1
+
+    source, size = generate(os.path.basename(args.input), name, width, height, loop_count, frames, chroma_key)
+    with open(args.output, 'w') as f:
+        f.write(source)
+    print('%s: %d frames %dx%d, %d bytes pre-decoded (%d bytes per raw frame)'
+          % (name, len(frames), width, height, size, width * height * 2))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: Apache-2.0
+"""
+Decode the pipeline telemetry of the USB webcam (uvc_telemetry_t in main/uvc_telemetry.h).
+
+The block is read from the vendor Extension Unit with GET_CUR. On Linux this uses the
+uvcvideo UVCIOC_CTRL_QUERY ioctl, the unit id is the one main/uvc_ctrl.c assigns to the
+Extension Unit (UVC_CTRL_XU_ID). A raw dump can be decoded with --file instead.
+"""
+
+import argparse
+import ctypes
+import fcntl
+import struct
+import sys
+
+# Must match uvc_telemetry_t, see the static asserts in main/uvc_telemetry.c
+TELEMETRY_FORMAT = '<4B2H5I2H4I'
+TELEMETRY_FIELDS = (
+    'version', 'size', 'format', 'jpeg_quality', 'width', 'height',
+    'uptime_ms', 'frames_captured', 'frames_sent', 'frames_dropped', 'fb_get_empty',
+    'fps_x10', 'requested_fps', 'heap_internal_free', 'heap_psram_free',
+    'capture_p50_us', 'capture_p99_us',
+)
+TELEMETRY_VERSION = 1
+TELEMETRY_SELECTOR = 0x01
+# UVC_CTRL_XU_ID in main/uvc_ctrl.h
+TELEMETRY_UNIT = 4
+
+FORMAT_NAMES = {1: 'MJPEG', 2: 'YUY2', 3: 'NV12', 4: 'GRAY8'}
+
+UVC_GET_CUR = 0x81
+
+
+class UvcXuControlQuery(ctypes.Structure):
+    _fields_ = [
+        ('unit', ctypes.c_uint8),
+        ('selector', ctypes.c_uint8),
+        ('query', ctypes.c_uint8),
+        ('size', ctypes.c_uint16),
+        ('data', ctypes.POINTER(ctypes.c_uint8)),
+    ]
+
+
+# _IOWR('u', 0x21, struct uvc_xu_control_query)
+UVCIOC_CTRL_QUERY = (3 << 30) | (ctypes.sizeof(UvcXuControlQuery) << 16) | (ord('u') << 8) | 0x21
+
+
+def decode(data):
+    size = struct.calcsize(TELEMETRY_FORMAT)
+    if len(data) < size:
+        raise ValueError('telemetry is %d bytes, expected %d' % (len(data), size))
+    values = dict(zip(TELEMETRY_FIELDS, struct.unpack_from(TELEMETRY_FORMAT, data)))
+    if values['version'] != TELEMETRY_VERSION:
+        raise ValueError('unsupported telemetry version %d' % values['version'])
+    return values
+
+
+def read_device(path, unit):
+    size = struct.calcsize(TELEMETRY_FORMAT)
+    buf = (ctypes.c_uint8 * size)()
+    query = UvcXuControlQuery(unit, TELEMETRY_SELECTOR, UVC_GET_CUR, size, buf)
+    with open(path, 'rb') as dev:
+        fcntl.ioctl(dev, UVCIOC_CTRL_QUERY, query)
+    return bytes(buf)
+
+
+def print_telemetry(t):
+    print('stream     %s %dx%d, quality %d' % (FORMAT_NAMES.get(t['format'], '-'), t['width'], t['height'], t['jpeg_quality']))
+    print('rate       %.1f fps (requested %d)' % (t['fps_x10'] / 10, t['requested_fps']))
+    print('frames     %d captured, %d sent, %d dropped, %d empty requests'
+          % (t['frames_captured'], t['frames_sent'], t['frames_dropped'], t['fb_get_empty']))
+    print('latency    p50 < %d us, p99 < %d us' % (t['capture_p50_us'], t['capture_p99_us']))
+    print('heap       %d internal, %d PSRAM bytes free' % (t['heap_internal_free'], t['heap_psram_free']))
+    print('uptime     %.1f s' % (t['uptime_ms'] / 1000))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('device', nargs='?', default='/dev/video0', help='video device node')
+    parser.add_argument('--unit', type=int, default=TELEMETRY_UNIT, help='Extension Unit id (default %(default)d)')
+    parser.add_argument('--file', help='decode a raw telemetry dump instead of querying a device')
+    args = parser.parse_args()
+
+    if args.file:
+        with open(args.file, 'rb') as f:
+            data = f.read()
+    else:
+        data = read_device(args.device, args.unit)
+
+    try:
+        print_telemetry(decode(data))
+    except ValueError as e:
+        print(e, file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())